@@ -1,6 +1,6 @@
 cd C:\Users\samue\source\repos\ChessGUI
 
-emcc -o index.html src\ChessEngine.cpp src\ChessGUI.cpp src\ChessUCI.cpp src\LevelChessboard.cpp src\LevelOptions.cpp src\LevelSetupChessboard.cpp src\LevelStartMenu.cpp src\Main.cpp src\Raylib_GameHeader.cpp ^
+emcc -o index.html src\ChessEngine.cpp src\ChessNNUE.cpp src\ChessProfiler.cpp src\ChessBatchEval.cpp src\ChessTuning.cpp src\ChessMicrobench.cpp src\ChessGUI.cpp src\ChessUCI.cpp src\LevelChessboard.cpp src\LevelOptions.cpp src\LevelSetupChessboard.cpp src\LevelStartMenu.cpp src\Main.cpp src\Raylib_GameHeader.cpp ^
  -Os -std=c++20 C:\raylib\raylib\src\web\libraylib.a ^
  -I. -I C:\raylib\raylib\src -I C:\raylib\raylib\src\external -I C:\Users\samue\source\repos\ChessGUI\src ^
  -L. -L C:\raylib\raylib\src ^
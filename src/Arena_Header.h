@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+//Bump allocator for the scratch memory of a single thread. Allocating only moves an offset, memory is given back in reverse order via Scope or all at once via reset.
+//Every thread owns its own Arena, so threads never contend for the allocator. The memory is reserved once and reused by every search.
+class Arena
+{
+public:
+	explicit Arena(std::size_t capacity): buffer{new std::byte[capacity]}, capacity{capacity} {}
+
+	Arena(const Arena&) = delete;
+	Arena &operator=(const Arena&) = delete;
+
+	//Frees everything allocated since it was created.
+	class Scope
+	{
+	public:
+		explicit Scope(Arena &arena): arena{arena}, marker{arena.used} {}
+		~Scope() { arena.used = marker; }
+
+		Scope(const Scope&) = delete;
+		Scope &operator=(const Scope&) = delete;
+
+	private:
+		Arena &arena;
+		const std::size_t marker;
+	};
+
+	//Returns n uninitialized objects of type T. Throws std::bad_alloc if the Arena is full.
+	template<typename T>
+	T *allocate(std::size_t n)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "The Arena never calls destructors.");
+
+		const std::size_t start = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+		if(start + n*sizeof(T) > capacity)
+			throw std::bad_alloc{};
+
+		used = start + n*sizeof(T);
+#ifndef NDEBUG
+		if(used > peakUsed)
+			peakUsed = used;
+#endif
+		return reinterpret_cast<T*>(buffer.get() + start);
+	}
+
+	//Free all allocations. Called at the start of every search.
+	void reset()
+	{
+		used = 0;
+	}
+
+	//Bytes in use right now.
+	std::size_t size() const
+	{
+		return used;
+	}
+
+	//The most bytes that were in use at once since the Arena was created. Only measured in debug builds, 0 otherwise.
+	std::size_t peak() const
+	{
+		return peakUsed;
+	}
+
+private:
+	std::unique_ptr<std::byte[]> buffer;
+	const std::size_t capacity;
+	std::size_t used = 0, peakUsed = 0;
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+//Signals a single job to stop. The job also stops once its deadline has passed or once it has counted too many nodes.
+//A token can have a parent, for example a token for all jobs of one user, and counts as cancelled if the parent is.
+class CancelToken
+{
+public:
+	static constexpr std::uint64_t checkInterval = 256;		//How many nodes a NodeCounter counts before it checks the token.
+
+	explicit CancelToken(const CancelToken *parent = nullptr): parent{parent} {}
+
+	//Stop the job. Can be called from any thread.
+	void cancel()
+	{
+		cancelled.store(true, std::memory_order_relaxed);
+	}
+
+	//Clear the flag, the counted nodes and all limits, so the token can be used for the next job.
+	void reset()
+	{
+		cancelled.store(false);
+		nodes.store(0);
+		nodeLimit.store(0);
+		deadline.store(0);
+	}
+
+	//Stop the job once seconds have passed from now. seconds <= 0 removes the deadline.
+	void setDeadline(double seconds)
+	{
+		if(seconds <= 0.0)
+		{
+			deadline.store(0);
+			return;
+		}
+
+		const auto duration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+		deadline.store((Clock::now() + duration).time_since_epoch().count());
+	}
+
+	//Stop the job once maxNodes have been counted. 0 removes the limit.
+	void setNodeLimit(std::uint64_t maxNodes)
+	{
+		nodeLimit.store(maxNodes);
+	}
+
+	//True if this token or one of its parents was cancelled or ran out of time or nodes.
+	bool isCancelled() const
+	{
+		return cancelled.load(std::memory_order_relaxed) || (parent != nullptr && parent->isCancelled());
+	}
+
+	//Add n nodes and check the limits. Returns true if the job should stop.
+	bool addNodes(std::uint64_t n)
+	{
+		const std::uint64_t total = nodes.fetch_add(n, std::memory_order_relaxed) + n;
+
+		const std::uint64_t maxNodes = nodeLimit.load(std::memory_order_relaxed);
+		if(maxNodes > 0 && total >= maxNodes)
+			cancel();
+
+		const Clock::rep end = deadline.load(std::memory_order_relaxed);
+		if(end > 0 && Clock::now().time_since_epoch().count() >= end)
+			cancel();
+
+		return isCancelled();
+	}
+
+	//Nodes counted so far.
+	std::uint64_t getNodes() const
+	{
+		return nodes.load(std::memory_order_relaxed);
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	const CancelToken *parent;
+	std::atomic<bool> cancelled{false};
+	std::atomic<std::uint64_t> nodes{0}, nodeLimit{0};
+	std::atomic<Clock::rep> deadline{0};
+};
+
+//Counts the nodes of a single thread and only reports them to its CancelToken every checkInterval nodes,
+//so searches neither share a cache line per node nor read the clock per node.
+class NodeCounter
+{
+public:
+	explicit NodeCounter(CancelToken &token): token{token}, stopped{token.isCancelled()} {}
+
+	~NodeCounter()
+	{
+		flush();
+	}
+
+	NodeCounter(const NodeCounter&) = delete;
+	NodeCounter &operator=(const NodeCounter&) = delete;
+
+	//Count one node. Returns true if the job should stop.
+	bool poll()
+	{
+		if(++pending >= CancelToken::checkInterval)
+			flush();
+		return stopped;
+	}
+
+	//Report the pending nodes to the token right away. Returns true if the job should stop.
+	bool flush()
+	{
+		stopped = token.addNodes(pending);
+		pending = 0;
+		return stopped;
+	}
+
+	//Result of the last check, without counting a node.
+	bool isStopped() const
+	{
+		return stopped;
+	}
+
+private:
+	CancelToken &token;
+	std::uint64_t pending = 0;
+	bool stopped;
+};
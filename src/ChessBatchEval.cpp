@@ -0,0 +1,404 @@
+#include "ChessBatchEval.h"
+
+//The vectorized path needs 256-bit integer instructions. Without them, every position is evaluated on its own.
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define BATCHEVAL_USE_AVX2
+#endif
+
+using namespace Chess;
+
+namespace
+{
+    //The Piece-Square-Table plus Piece-Value of every square, split into bit-planes: value(k) = base + sum_b 2^b * planes[b](k).
+    //The weight of a bitboard is then base*popcount(pieces) + sum_b 2^b * popcount(pieces & planes[b]).
+    struct PieceTables
+    {
+        u64 planes[2][6][2][32]{};  //Indexed via [PColour][PType][lateGame][bit].
+        int base[2][6][2]{};
+        int nPlanes = 0;
+    };
+
+    const PieceTables pieceTables = []()
+    {
+        static constexpr const int (*PST[6])[8][8] = {KingPST, QueenPST, BishopPST, KnightPST, RookPST, PawnPST};
+        PieceTables tables{};
+
+        for(int l=0; l<2; l++)
+        {
+            for(int t=0; t<6; t++)
+            {
+                for(int lateGame=0; lateGame<2; lateGame++)
+                {
+                    //For Black, the PST-Matrix must be mirrored.
+                    int values[64]{};
+                    for(int k=0; k<64; k++)
+                    {
+                        const int i = (l==PWHITE) ? k/8 : 7-k/8;
+                        values[k] = PST[t][lateGame][i][k%8] + pieceValue[lateGame][t];
+                    }
+
+                    const int base = *std::min_element(values, values+64);
+                    tables.base[l][t][lateGame] = base;
+
+                    for(int k=0; k<64; k++)
+                    {
+                        const unsigned int offset = (unsigned int)(values[k] - base);
+                        for(int b=0; b<32; b++)
+                        {
+                            if(offset & (1u << b))
+                            {
+                                tables.planes[l][t][lateGame][b] |= (u64)1 << k;
+                                tables.nPlanes = std::max(tables.nPlanes, b+1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return tables;
+    }();
+
+    //Weight of a finished game.
+    int getGameOverWeight(const BatchEval::Position &position)
+    {
+        if(position.checkmate[PWHITE])
+            return -9999;
+        else if(position.checkmate[PBLACK])
+            return +9999;
+        else
+            return 0;
+    }
+
+#if defined(BATCHEVAL_USE_AVX2)
+
+    //Number of set bits in each of the 4 64-bit lanes: Look up the count of every nibble and sum the bytes of each lane.
+    __m256i popcount(__m256i x)
+    {
+        const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+        const __m256i lowNibbles = _mm256_set1_epi8(0x0f);
+        const __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, lowNibbles));
+        const __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), lowNibbles));
+        return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+    }
+
+    //Pick value0 or value1 for every lane depending on the lateGame mask.
+    __m256i select(__m256i lateGame, long long value0, long long value1)
+    {
+        return _mm256_blendv_epi8(_mm256_set1_epi64x(value0), _mm256_set1_epi64x(value1), lateGame);
+    }
+
+    //Multiply small non-negative counts with signed 32-bit values.
+    __m256i multiply(__m256i count, __m256i value)
+    {
+        return _mm256_mul_epi32(count, value);
+    }
+
+    //Vector versions of the bitboard shifts in ChessEngine.
+    __m256i shiftLeft(__m256i x)
+    {
+        return _mm256_srli_epi64(_mm256_andnot_si256(_mm256_set1_epi64x((long long)bitboardFile[0]), x), 1);
+    }
+
+    __m256i shiftRight(__m256i x)
+    {
+        return _mm256_slli_epi64(_mm256_andnot_si256(_mm256_set1_epi64x((long long)bitboardFile[7]), x), 1);
+    }
+
+    __m256i shiftForward(__m256i x, PColour colour)
+    {
+        return (colour==PWHITE) ? _mm256_srli_epi64(x, 8) : _mm256_slli_epi64(x, 8);
+    }
+
+    __m256i shiftBackward(__m256i x, PColour colour)
+    {
+        return (colour==PWHITE) ? _mm256_slli_epi64(x, 8) : _mm256_srli_epi64(x, 8);
+    }
+
+    __m256i fillForward(__m256i x, PColour colour)
+    {
+        if(colour==PWHITE)
+        {
+            x = _mm256_or_si256(x, _mm256_srli_epi64(x, 8));
+            x = _mm256_or_si256(x, _mm256_srli_epi64(x, 16));
+            x = _mm256_or_si256(x, _mm256_srli_epi64(x, 32));
+        }
+        else
+        {
+            x = _mm256_or_si256(x, _mm256_slli_epi64(x, 8));
+            x = _mm256_or_si256(x, _mm256_slli_epi64(x, 16));
+            x = _mm256_or_si256(x, _mm256_slli_epi64(x, 32));
+        }
+        return x;
+    }
+
+    __m256i pawnAttacks(__m256i pawns, PColour colour)
+    {
+        return shiftForward(_mm256_or_si256(shiftLeft(pawns), shiftRight(pawns)), colour);
+    }
+
+    //Attacks of a single bit per lane.
+    __m256i knightAttacks(__m256i piece)
+    {
+        const __m256i left1 = shiftLeft(piece), left2 = shiftLeft(left1);
+        const __m256i right1 = shiftRight(piece), right2 = shiftRight(right1);
+        const __m256i one = _mm256_or_si256(left1, right1), two = _mm256_or_si256(left2, right2);
+        return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi64(one, 16), _mm256_srli_epi64(one, 16)),
+                               _mm256_or_si256(_mm256_slli_epi64(two, 8), _mm256_srli_epi64(two, 8)));
+    }
+
+    __m256i kingAttacks(__m256i piece)
+    {
+        const __m256i sides = _mm256_or_si256(shiftLeft(piece), shiftRight(piece));
+        const __m256i row = _mm256_or_si256(piece, sides);
+        return _mm256_or_si256(sides, _mm256_or_si256(_mm256_slli_epi64(row, 8), _mm256_srli_epi64(row, 8)));
+    }
+
+    //Kogge-Stone fill along one direction until the first occupied square, which is included. 
+    //shift is the bit-distance of one step, mask removes the squares that wrapped around the board.
+    template<int shift>
+    __m256i slide(__m256i piece, __m256i empty, __m256i mask)
+    {
+        auto step = [](__m256i x, int n){ return (shift > 0) ? _mm256_slli_epi64(x, shift*n) : _mm256_srli_epi64(x, -shift*n); };
+
+        empty = _mm256_and_si256(empty, mask);
+        piece = _mm256_or_si256(piece, _mm256_and_si256(empty, step(piece, 1)));
+        empty = _mm256_and_si256(empty, step(empty, 1));
+        piece = _mm256_or_si256(piece, _mm256_and_si256(empty, step(piece, 2)));
+        empty = _mm256_and_si256(empty, step(empty, 2));
+        piece = _mm256_or_si256(piece, _mm256_and_si256(empty, step(piece, 4)));
+        return _mm256_and_si256(step(piece, 1), mask);
+    }
+
+    __m256i rookAttacks(__m256i piece, __m256i empty)
+    {
+        const __m256i all = _mm256_set1_epi64x(-1);
+        const __m256i notFile0 = _mm256_set1_epi64x((long long)~bitboardFile[0]), notFile7 = _mm256_set1_epi64x((long long)~bitboardFile[7]);
+        return _mm256_or_si256(_mm256_or_si256(slide<+1>(piece, empty, notFile0), slide<-1>(piece, empty, notFile7)),
+                               _mm256_or_si256(slide<+8>(piece, empty, all), slide<-8>(piece, empty, all)));
+    }
+
+    __m256i bishopAttacks(__m256i piece, __m256i empty)
+    {
+        const __m256i notFile0 = _mm256_set1_epi64x((long long)~bitboardFile[0]), notFile7 = _mm256_set1_epi64x((long long)~bitboardFile[7]);
+        return _mm256_or_si256(_mm256_or_si256(slide<+9>(piece, empty, notFile0), slide<+7>(piece, empty, notFile7)),
+                               _mm256_or_si256(slide<-7>(piece, empty, notFile0), slide<-9>(piece, empty, notFile7)));
+    }
+
+    //Look up table[lateGame][count] for every lane.
+    __m256i lookup(const int *table, int size, __m256i lateGame, __m256i count)
+    {
+        const __m256i index = _mm256_add_epi64(_mm256_and_si256(lateGame, _mm256_set1_epi64x(size)), count);
+        return _mm256_cvtepi32_epi64(_mm256_i64gather_epi32(table, index, 4));
+    }
+
+    //All handcrafted Weights of 4 positions, see getPieceWeight, getPawnWeight and getMobilityWeight.
+    __m256i evaluateBlock(const __m256i bitboards[2][6], __m256i lateGame)
+    {
+        __m256i occupiedColour[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+        for(int l=0; l<2; l++)
+        {
+            for(int t=0; t<6; t++)
+                occupiedColour[l] = _mm256_or_si256(occupiedColour[l], bitboards[l][t]);
+        }
+        const __m256i occupied = _mm256_or_si256(occupiedColour[PWHITE], occupiedColour[PBLACK]);
+
+        __m256i weight = _mm256_setzero_si256();
+
+        for(int l=0; l<2; l++)
+        {
+            const PColour colour = (PColour)l;
+            const PColour enemyColour = (l==PWHITE) ? PBLACK : PWHITE;
+            __m256i colourWeight = _mm256_setzero_si256();
+
+            //Piece-Square-Tables and Piece-Values.
+            for(int t=0; t<6; t++)
+            {
+                const __m256i pieces = bitboards[l][t];
+                const int *base = pieceTables.base[l][t];
+                colourWeight = _mm256_add_epi64(colourWeight, multiply(popcount(pieces), select(lateGame, base[0], base[1])));
+
+                for(int b=0; b<pieceTables.nPlanes; b++)
+                {
+                    const __m256i plane = select(lateGame, (long long)pieceTables.planes[l][t][0][b], (long long)pieceTables.planes[l][t][1][b]);
+                    colourWeight = _mm256_add_epi64(colourWeight, _mm256_slli_epi64(popcount(_mm256_and_si256(pieces, plane)), b));
+                }
+            }
+
+            //Pawn-Structure.
+            const __m256i pawns = bitboards[l][PAWN];
+            const __m256i enemyPawns = bitboards[enemyColour][PAWN];
+
+            __m256i nPairs = _mm256_setzero_si256();
+            for(int d=1; d<6; d++)
+                nPairs = _mm256_add_epi64(nPairs, popcount(_mm256_and_si256(pawns, _mm256_srli_epi64(pawns, 8*d))));
+            colourWeight = _mm256_add_epi64(colourWeight, multiply(_mm256_slli_epi64(nPairs, 1), select(lateGame, PawnDoubled[0], PawnDoubled[1])));
+
+            const __m256i files = _mm256_or_si256(fillForward(pawns, colour), fillForward(pawns, enemyColour));
+            const __m256i isolated = _mm256_andnot_si256(_mm256_or_si256(shiftLeft(files), shiftRight(files)), pawns);
+            colourWeight = _mm256_add_epi64(colourWeight, multiply(popcount(isolated), select(lateGame, PawnIsolated[0], PawnIsolated[1])));
+
+            const __m256i pushBlocked = shiftBackward(_mm256_and_si256(shiftForward(pawns, colour), occupied), colour);
+            const __m256i canCaptureLeft  = shiftRight(shiftBackward(_mm256_and_si256(shiftForward(shiftLeft(pawns), colour), occupiedColour[enemyColour]), colour));
+            const __m256i canCaptureRight = shiftLeft(shiftBackward(_mm256_and_si256(shiftForward(shiftRight(pawns), colour), occupiedColour[enemyColour]), colour));
+            const __m256i blocked = _mm256_andnot_si256(_mm256_or_si256(canCaptureLeft, canCaptureRight), pushBlocked);
+            colourWeight = _mm256_add_epi64(colourWeight, multiply(popcount(blocked), select(lateGame, PawnBlocked[0], PawnBlocked[1])));
+
+            const __m256i attackSpan = fillForward(pawnAttacks(pawns, colour), colour);
+            const __m256i stops = shiftForward(pawns, colour);
+            const __m256i backward = shiftBackward(_mm256_andnot_si256(attackSpan, _mm256_and_si256(stops, pawnAttacks(enemyPawns, enemyColour))), colour);
+            colourWeight = _mm256_add_epi64(colourWeight, multiply(popcount(backward), select(lateGame, PawnBackward[0], PawnBackward[1])));
+
+            const __m256i enemyFront = fillForward(shiftForward(enemyPawns, enemyColour), enemyColour);
+            const __m256i passed = _mm256_andnot_si256(_mm256_or_si256(enemyFront, _mm256_or_si256(shiftLeft(enemyFront), shiftRight(enemyFront))), pawns);
+            for(int rank=1; rank<7; rank++)
+            {
+                const int j = (l==PWHITE) ? 7-rank : rank;
+                const __m256i passedRow = _mm256_and_si256(passed, _mm256_set1_epi64x((long long)bitboardRow[j]));
+                colourWeight = _mm256_add_epi64(colourWeight, multiply(popcount(passedRow), select(lateGame, PawnPassed[0][rank], PawnPassed[1][rank])));
+            }
+
+            //Mobility: Every piece is looked up on its own, so the lowest remaining piece of every lane is processed at once.
+            const __m256i zero = _mm256_setzero_si256(), all = _mm256_set1_epi64x(-1);
+            const __m256i empty = _mm256_xor_si256(occupied, all);
+            const __m256i mobilityArea = _mm256_andnot_si256(_mm256_or_si256(occupiedColour[l], pawnAttacks(enemyPawns, enemyColour)), all);
+            for(int t=KING; t<PAWN; t++)
+            {
+                __m256i pieces = bitboards[l][t];
+                while(!_mm256_testz_si256(pieces, pieces))
+                {
+                    const __m256i piece = _mm256_and_si256(pieces, _mm256_sub_epi64(zero, pieces));
+                    pieces = _mm256_xor_si256(pieces, piece);
+
+                    __m256i attacks = zero;
+                    const int *table = nullptr;
+                    int size = 0;
+                    switch(t)
+                    {
+                    case KING:
+                        attacks = kingAttacks(piece);
+                        table = &KingMobility[0][0];
+                        size = 9;
+                        break;
+
+                    case QUEEN:
+                        attacks = _mm256_or_si256(rookAttacks(piece, empty), bishopAttacks(piece, empty));
+                        table = &QueenMobility[0][0];
+                        size = 28;
+                        break;
+
+                    case BISHOP:
+                        attacks = bishopAttacks(piece, empty);
+                        table = &BishopMobility[0][0];
+                        size = 14;
+                        break;
+
+                    case KNIGHT:
+                        attacks = knightAttacks(piece);
+                        table = &KnightMobility[0][0];
+                        size = 9;
+                        break;
+
+                    case ROOK:
+                        attacks = rookAttacks(piece, empty);
+                        table = &RookMobility[0][0];
+                        size = 15;
+                        break;
+                    }
+
+                    const __m256i present = _mm256_andnot_si256(_mm256_cmpeq_epi64(piece, zero), all);
+                    const __m256i value = lookup(table, size, lateGame, popcount(_mm256_and_si256(attacks, mobilityArea)));
+                    colourWeight = _mm256_add_epi64(colourWeight, _mm256_and_si256(value, present));
+                }
+            }
+
+            //King-Safety: Look from the King outwards for enemy pieces that attack it.
+            const __m256i king = _mm256_and_si256(bitboards[l][KING], _mm256_sub_epi64(zero, bitboards[l][KING]));
+            const __m256i * const enemy = bitboards[enemyColour];
+            __m256i attackers = _mm256_and_si256(pawnAttacks(king, colour), enemy[PAWN]);
+            attackers = _mm256_or_si256(attackers, _mm256_and_si256(knightAttacks(king), enemy[KNIGHT]));
+            attackers = _mm256_or_si256(attackers, _mm256_and_si256(kingAttacks(king), enemy[KING]));
+            attackers = _mm256_or_si256(attackers, _mm256_and_si256(rookAttacks(king, empty), _mm256_or_si256(enemy[ROOK], enemy[QUEEN])));
+            attackers = _mm256_or_si256(attackers, _mm256_and_si256(bishopAttacks(king, empty), _mm256_or_si256(enemy[BISHOP], enemy[QUEEN])));
+            const __m256i inCheck = _mm256_andnot_si256(_mm256_cmpeq_epi64(attackers, zero), all);
+            colourWeight = _mm256_add_epi64(colourWeight, _mm256_and_si256(inCheck, select(lateGame, KingCheck[0], KingCheck[1])));
+
+            weight = (l==PWHITE) ? _mm256_add_epi64(weight, colourWeight) : _mm256_sub_epi64(weight, colourWeight);
+        }
+
+        return weight;
+    }
+
+#endif
+}
+
+BatchEval::Position BatchEval::getPosition(const Engine &engine)
+{
+    Position position{};
+    engine.getPieceBitboards(position.bitboards);
+    position.turnColour = engine.turnColour;
+    position.lateGame = engine.lateGame;
+    position.checkmate[PWHITE] = engine.checkmate[PWHITE];
+    position.checkmate[PBLACK] = engine.checkmate[PBLACK];
+    return position;
+}
+
+int BatchEval::evaluate(const Position &position)
+{
+    if(position.turnColour == PNONE)
+        return getGameOverWeight(position);
+
+    return getHandcraftedWeight(position.bitboards, position.lateGame);
+}
+
+void BatchEval::evaluate(const Position *positions, std::size_t n, int *weights)
+{
+    std::size_t first = 0;
+
+#if defined(BATCHEVAL_USE_AVX2)
+    for(; first+4 <= n; first += 4)
+    {
+        const Position *block = positions + first;
+
+        //Transpose the block into a structure of arrays: one vector per bitboard, holding all 4 positions.
+        alignas(32) u64 lanes[2][6][4];
+        alignas(32) u64 lateGameLanes[4];
+        for(int lane=0; lane<4; lane++)
+        {
+            for(int l=0; l<2; l++)
+            {
+                for(int t=0; t<6; t++)
+                    lanes[l][t][lane] = block[lane].bitboards[l][t];
+            }
+            lateGameLanes[lane] = block[lane].lateGame ? ~(u64)0 : 0;
+        }
+
+        __m256i bitboards[2][6];
+        for(int l=0; l<2; l++)
+        {
+            for(int t=0; t<6; t++)
+                bitboards[l][t] = _mm256_load_si256((const __m256i*)lanes[l][t]);
+        }
+        const __m256i lateGame = _mm256_load_si256((const __m256i*)lateGameLanes);
+
+        alignas(32) int64_t blockWeights[4];
+        _mm256_store_si256((__m256i*)blockWeights, evaluateBlock(bitboards, lateGame));
+
+        for(int lane=0; lane<4; lane++)
+            weights[first+lane] = (block[lane].turnColour == PNONE) ? getGameOverWeight(block[lane]) : (int)blockWeights[lane];
+    }
+#endif
+
+    for(; first<n; first++)
+        weights[first] = evaluate(positions[first]);
+}
+
+const char *BatchEval::simdName()
+{
+#if defined(BATCHEVAL_USE_AVX2)
+    return "AVX2";
+#else
+    return "none";
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "ChessEngine.h"
+
+//Handcrafted evaluation of many independent positions at once.
+//Blocks of 4 positions are transposed into a structure-of-arrays layout, so every AVX2-instruction works on all 4 positions.
+namespace Chess::BatchEval
+{
+    //Everything the handcrafted evaluation needs from a board.
+    struct Position
+    {
+        u64 bitboards[2][6]{};          //Indexed via [PColour][PType].
+        PColour turnColour = PWHITE;    //PNONE if the game is over.
+        bool lateGame = false;
+        bool checkmate[2]{};
+    };
+
+    //Copy the current board of an Engine.
+    Position getPosition(const Engine &engine);
+
+    //Evaluate n positions from the perspective of White. The weights are identical to getBoardWeight with the handcrafted evaluation.
+    void evaluate(const Position *positions, std::size_t n, int *weights);
+
+    //Evaluate a single position without SIMD.
+    int evaluate(const Position &position);
+
+    //Name of the SIMD instruction set used for the batches.
+    const char *simdName();
+}
@@ -5,14 +5,10 @@ using namespace Chess;
 
 void Chess::bitboardInitializeKeys()
 {
-    u64 n = 1;
-    for(int i=0; i<8; i++)
+    //Bit k belongs to the square k = i + 8*j, such that shifting by 1 changes the file and shifting by 8 changes the row.
+    for(int k=0; k<64; k++)
     {
-        for(int j=0; j<8; j++)
-        {
-            bitboardKey[i+(8*j)] = n;
-            n = 2*n;
-        }
+        bitboardKey[k] = (u64)1 << k;
     }
 }
 
@@ -28,6 +24,178 @@ bool Chess::bitboardCheck(u64 bitboard, const BoardPos &pos)
     return (bitboard & bitboardKey[k]);
 }
 
+void Chess::bitboardInitializeMasks()
+{
+    for(int n=0; n<8; n++)
+    {
+        bitboardFile[n] = 0;
+        bitboardRow[n] = 0;
+        for(int m=0; m<8; m++)
+        {
+            bitboardFile[n] |= bitboardKey[n+(8*m)];
+            bitboardRow[n] |= bitboardKey[m+(8*n)];
+        }
+    }
+}
+
+int Chess::bitboardCount(u64 bitboard)
+{
+    return std::popcount(bitboard);
+}
+
+u64 Chess::bitboardShiftLeft(u64 bitboard)
+{
+    return (bitboard & ~bitboardFile[0]) >> 1;
+}
+
+u64 Chess::bitboardShiftRight(u64 bitboard)
+{
+    return (bitboard & ~bitboardFile[7]) << 1;
+}
+
+u64 Chess::bitboardShiftForward(u64 bitboard, PColour colour)
+{
+    return (colour==PWHITE) ? (bitboard >> 8) : (bitboard << 8);
+}
+
+u64 Chess::bitboardShiftBackward(u64 bitboard, PColour colour)
+{
+    return (colour==PWHITE) ? (bitboard << 8) : (bitboard >> 8);
+}
+
+u64 Chess::bitboardFillForward(u64 bitboard, PColour colour)
+{
+    if(colour==PWHITE)
+    {
+        bitboard |= (bitboard >> 8);
+        bitboard |= (bitboard >> 16);
+        bitboard |= (bitboard >> 32);
+    }
+    else
+    {
+        bitboard |= (bitboard << 8);
+        bitboard |= (bitboard << 16);
+        bitboard |= (bitboard << 32);
+    }
+    return bitboard;
+}
+
+u64 Chess::bitboardFillBackward(u64 bitboard, PColour colour)
+{
+    return bitboardFillForward(bitboard, (colour==PWHITE) ? PBLACK : PWHITE);
+}
+
+u64 Chess::bitboardPawnAttacks(u64 pawns, PColour colour)
+{
+    return bitboardShiftForward(bitboardShiftLeft(pawns) | bitboardShiftRight(pawns), colour);
+}
+
+void Chess::bitboardInitializeAttacks()
+{
+    const int rayDirections[8][2] = {{1,0},{0,1},{1,1},{-1,1},{-1,0},{0,-1},{-1,-1},{1,-1}};
+    const int knightJumps[8][2] = {{2,-1},{1,-2},{-1,-2},{-2,-1},{-2,1},{-1,2},{1,2},{2,1}};
+
+    for(int k=0; k<64; k++)
+    {
+        const int i = k%8;
+        const int j = k/8;
+
+        bitboardKnightAttacks[k] = 0;
+        bitboardKingAttacks[k] = 0;
+
+        for(int n=0; n<8; n++)
+        {
+            //Knight
+            const BoardPos knightPos = {i + knightJumps[n][0], j + knightJumps[n][1]};
+            if(knightPos.i >= 0 && knightPos.i < 8 && knightPos.j >= 0 && knightPos.j < 8)
+                bitboardFlip(bitboardKnightAttacks[k], knightPos);
+
+            //King
+            const BoardPos kingPos = {i + rayDirections[n][0], j + rayDirections[n][1]};
+            if(kingPos.i >= 0 && kingPos.i < 8 && kingPos.j >= 0 && kingPos.j < 8)
+                bitboardFlip(bitboardKingAttacks[k], kingPos);
+
+            //Rays
+            bitboardRays[n][k] = 0;
+            BoardPos rayPos = kingPos;
+            while(rayPos.i >= 0 && rayPos.i < 8 && rayPos.j >= 0 && rayPos.j < 8)
+            {
+                bitboardFlip(bitboardRays[n][k], rayPos);
+                rayPos.i += rayDirections[n][0];
+                rayPos.j += rayDirections[n][1];
+            }
+        }
+    }
+}
+
+//Returns the Ray in direction d from square k, cut off behind the first occupied square.
+static u64 bitboardRayAttacks(int d, int k, u64 occupied)
+{
+    u64 attacks = bitboardRays[d][k];
+    const u64 blockers = attacks & occupied;
+    if(blockers)
+    {
+        const int blocker = (d<4) ? std::countr_zero(blockers) : 63 - std::countl_zero(blockers);
+        attacks ^= bitboardRays[d][blocker];
+    }
+    return attacks;
+}
+
+u64 Chess::bitboardRookAttacks(int k, u64 occupied)
+{
+    return bitboardRayAttacks(0, k, occupied) | bitboardRayAttacks(1, k, occupied) | bitboardRayAttacks(4, k, occupied) | bitboardRayAttacks(5, k, occupied);
+}
+
+u64 Chess::bitboardBishopAttacks(int k, u64 occupied)
+{
+    return bitboardRayAttacks(2, k, occupied) | bitboardRayAttacks(3, k, occupied) | bitboardRayAttacks(6, k, occupied) | bitboardRayAttacks(7, k, occupied);
+}
+
+bool Chess::bitboardSquareAttacked(int k, PColour colour, const u64 bitboards[2][6], u64 occupied)
+{
+    //A Pawn of the other colour on square k would attack exactly the squares from which Pawns of colour attack k.
+    const PColour otherColour = (colour==PWHITE) ? PBLACK : PWHITE;
+    if(bitboardPawnAttacks(bitboardKey[k], otherColour) & bitboards[colour][PAWN])
+        return true;
+
+    if(bitboardKnightAttacks[k] & bitboards[colour][KNIGHT])
+        return true;
+
+    if(bitboardKingAttacks[k] & bitboards[colour][KING])
+        return true;
+
+    if(bitboardRookAttacks(k, occupied) & (bitboards[colour][ROOK] | bitboards[colour][QUEEN]))
+        return true;
+
+    if(bitboardBishopAttacks(k, occupied) & (bitboards[colour][BISHOP] | bitboards[colour][QUEEN]))
+        return true;
+
+    return false;
+}
+
+void Chess::zobristInitializeKeys()
+{
+    //Fixed seed instead of Random::generator.
+    std::mt19937_64 generator{0x5A0B7157ULL};
+
+    for(int l=0; l<2; l++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            for(int k=0; k<64; k++)
+                zobristPieces[l][t][k] = generator();
+        }
+    }
+
+    for(int n=0; n<16; n++)
+        zobristCastling[n] = generator();
+
+    for(int i=0; i<8; i++)
+        zobristEnPassant[i] = generator();
+
+    zobristTurn = generator();
+}
+
 //Enum Identity Functions
 
 std::string Chess::PTypeString(PType type)
@@ -75,6 +243,383 @@ std::string Chess::PColourString(PColour colour)
     }
 }
 
+//Position Functions
+
+u64 Position::occupied(PColour colour) const
+{
+    const u64 *pieces = bitboards[colour];
+    return pieces[KING] | pieces[QUEEN] | pieces[BISHOP] | pieces[KNIGHT] | pieces[ROOK] | pieces[PAWN];
+}
+
+u64 Position::occupied() const
+{
+    return occupied(PWHITE) | occupied(PBLACK);
+}
+
+bool Position::getPiece(int k, PColour &colour, PType &type) const
+{
+    for(int l=0; l<2; l++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            if(bitboards[l][t] & bitboardKey[k])
+            {
+                colour = (PColour)l;
+                type = (PType)t;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+u64 Position::computeHash() const
+{
+    u64 key = 0;
+
+    for(int l=0; l<2; l++)
+    {
+        for(int t=0; t<6; t++)
+        {
+            u64 pieces = bitboards[l][t];
+            while(pieces)
+            {
+                key ^= zobristPieces[l][t][std::countr_zero(pieces)];
+                pieces &= pieces - 1;
+            }
+        }
+    }
+
+    key ^= zobristCastling[castling];
+    if(enpassant >= 0)
+        key ^= zobristEnPassant[enpassant % 8];
+    if(turnColour == PBLACK)
+        key ^= zobristTurn;
+
+    return key;
+}
+
+bool Position::inCheck(PColour colour) const
+{
+    const u64 king = bitboards[colour][KING];
+    if(king == 0)
+        return false;
+
+    const PColour otherColour = (colour==PWHITE) ? PBLACK : PWHITE;
+    return bitboardSquareAttacked(std::countr_zero(king), otherColour, bitboards, occupied());
+}
+
+bool Position::isLateGame() const
+{
+    if(bitboards[PWHITE][QUEEN] == 0 && bitboards[PBLACK][QUEEN] == 0)
+        return true;
+
+    for(int l=0; l<2; l++)
+    {
+        const int nAlive = bitboardCount(occupied((PColour)l));
+        const bool minorPieceAlive = (bitboards[l][BISHOP] | bitboards[l][KNIGHT]) != 0;
+        if( nAlive <= 2 || (nAlive == 3 && minorPieceAlive) )
+            return true;
+    }
+
+    return false;
+}
+
+bool Position::canCastle(bool kingSide) const
+{
+    const PColour l = turnColour;
+    if(l == PNONE)
+        return false;
+
+    const PColour otherColour = (l==PWHITE) ? PBLACK : PWHITE;
+    const int j = (l==PWHITE) ? 7 : 0;
+    const int kingSquare = 4 + 8*j;
+    const std::uint8_t right = kingSide ? ((l==PWHITE) ? CASTLEWHITEKING : CASTLEBLACKKING) : ((l==PWHITE) ? CASTLEWHITEQUEEN : CASTLEBLACKQUEEN);
+    const int rookSquare = (kingSide ? 7 : 0) + 8*j;
+    const int passedSquare = (kingSide ? 5 : 3) + 8*j;
+    const u64 between = kingSide ? (bitboardKey[5 + 8*j] | bitboardKey[6 + 8*j]) : (bitboardKey[1 + 8*j] | bitboardKey[2 + 8*j] | bitboardKey[3 + 8*j]);
+    const u64 all = occupied();
+
+    return (castling & right) && (bitboards[l][KING] & bitboardKey[kingSquare]) && (bitboards[l][ROOK] & bitboardKey[rookSquare]) && !(all & between)
+        && !bitboardSquareAttacked(kingSquare, otherColour, bitboards, all) && !bitboardSquareAttacked(passedSquare, otherColour, bitboards, all);
+}
+
+void Position::generateMoves(MoveList &moveList) const
+{
+    moveList.clear();
+    if(turnColour == PNONE)
+        return;
+
+    const PColour l = turnColour;
+    const PColour otherColour = (l==PWHITE) ? PBLACK : PWHITE;
+    const u64 own = occupied(l), enemy = occupied(otherColour), all = own | enemy;
+
+    //Add a move from square start to every square in targets.
+    auto addMoves = [&moveList](int start, u64 targets, PType type)
+    {
+        while(targets)
+        {
+            const int end = std::countr_zero(targets);
+            targets &= targets - 1;
+            moveList.push_back({{start%8, start/8}, {end%8, end/8}, type});
+        }
+    };
+
+    //Pieces
+    for(int t=KING; t<PAWN; t++)
+    {
+        u64 pieces = bitboards[l][t];
+        while(pieces)
+        {
+            const int k = std::countr_zero(pieces);
+            pieces &= pieces - 1;
+
+            u64 attacks = 0;
+            switch(t)
+            {
+            case KING:
+                attacks = bitboardKingAttacks[k];
+                break;
+
+            case QUEEN:
+                attacks = bitboardRookAttacks(k, all) | bitboardBishopAttacks(k, all);
+                break;
+
+            case BISHOP:
+                attacks = bitboardBishopAttacks(k, all);
+                break;
+
+            case KNIGHT:
+                attacks = bitboardKnightAttacks[k];
+                break;
+
+            case ROOK:
+                attacks = bitboardRookAttacks(k, all);
+                break;
+            }
+
+            addMoves(k, attacks & ~own, (PType)t);
+        }
+    }
+
+    //Castling. makeMove checks the square the King ends on.
+    const int j = (l==PWHITE) ? 7 : 0;
+    if( castling != 0 )
+    {
+        if( canCastle(true) )
+            moveList.push_back({{4,j}, {6,j}, KING});
+        if( canCastle(false) )
+            moveList.push_back({{4,j}, {2,j}, KING});
+    }
+
+    //Pawns
+    const int forward = (l==PWHITE) ? -8 : +8;
+    const int jStart = (l==PWHITE) ? 6 : 1;
+    const int jPromotion = (l==PWHITE) ? 0 : 7;
+
+    //Add a Pawn-move, or all four Pawn-Transforms if it reaches the last row.
+    auto addPawnMove = [&moveList, jPromotion](int start, int end)
+    {
+        const BoardPos startPos{start%8, start/8}, endPos{end%8, end/8};
+        if(endPos.j == jPromotion)
+        {
+            moveList.push_back({startPos, endPos, QUEEN});
+            moveList.push_back({startPos, endPos, BISHOP});
+            moveList.push_back({startPos, endPos, KNIGHT});
+            moveList.push_back({startPos, endPos, ROOK});
+        }
+        else
+            moveList.push_back({startPos, endPos, PAWN});
+    };
+
+    u64 pawns = bitboards[l][PAWN];
+    while(pawns)
+    {
+        const int k = std::countr_zero(pawns);
+        pawns &= pawns - 1;
+
+        //Forward
+        const int end = k + forward;
+        if(!(all & bitboardKey[end]))
+        {
+            addPawnMove(k, end);
+            if(k/8 == jStart && !(all & bitboardKey[end + forward]))
+                addPawnMove(k, end + forward);
+        }
+
+        //Capture
+        u64 captures = bitboardPawnAttacks(bitboardKey[k], l);
+        while(captures)
+        {
+            const int target = std::countr_zero(captures);
+            captures &= captures - 1;
+
+            if( (enemy & bitboardKey[target]) || target == enpassant )
+                addPawnMove(k, target);
+        }
+    }
+}
+
+bool Position::makeMove(const ChessMove &move, Position &next) const
+{
+    PROFILE_SCOPE(MAKEMOVE);
+    next = *this;
+
+    const PColour l = turnColour;
+    const PColour otherColour = (l==PWHITE) ? PBLACK : PWHITE;
+    const int start = move.start.i + 8*move.start.j;
+    const int end = move.end.i + 8*move.end.j;
+
+    PColour colour{};
+    PType type{};
+    if(l == PNONE || !getPiece(start, colour, type) || colour != l)
+        return false;
+
+    //The old en-passant Square and Castling-Rights are removed from the hash and added again once they are updated.
+    if(enpassant >= 0)
+        next.hash ^= zobristEnPassant[enpassant % 8];
+    next.hash ^= zobristCastling[castling];
+    next.enpassant = -1;
+
+    //Capture
+    PColour capturedColour{};
+    PType capturedType{};
+    if(getPiece(end, capturedColour, capturedType))
+    {
+        next.bitboards[otherColour][capturedType] ^= bitboardKey[end];
+        next.hash ^= zobristPieces[otherColour][capturedType][end];
+        next.turnsUntilDrawCounter = 0;
+    }
+
+    //Move the Piece itself. Only Pawns can change their type.
+    const PType endType = (type == PAWN) ? move.endType : type;
+    next.bitboards[l][type] ^= bitboardKey[start];
+    next.bitboards[l][endType] ^= bitboardKey[end];
+    next.hash ^= zobristPieces[l][type][start] ^ zobristPieces[l][endType][end];
+
+    if(type == PAWN)
+    {
+        next.turnsUntilDrawCounter = 0;
+
+        //En passant
+        if(end == enpassant)
+        {
+            const int captured = move.end.i + 8*move.start.j;
+            next.bitboards[otherColour][PAWN] ^= bitboardKey[captured];
+            next.hash ^= zobristPieces[otherColour][PAWN][captured];
+        }
+
+        //Double Move
+        if(abs(end - start) == 16)
+            next.enpassant = (std::int8_t)((start + end) / 2);
+    }
+
+    //Castling
+    if(type == KING && abs(move.end.i - move.start.i) == 2)
+    {
+        const int rookStart = ((move.end.i < move.start.i) ? 0 : 7) + 8*move.start.j;
+        const int rookEnd = ((move.end.i < move.start.i) ? 3 : 5) + 8*move.start.j;
+        next.bitboards[l][ROOK] ^= bitboardKey[rookStart] | bitboardKey[rookEnd];
+        next.hash ^= zobristPieces[l][ROOK][rookStart] ^ zobristPieces[l][ROOK][rookEnd];
+    }
+
+    //A move from or to the start square of a King or Rook removes the corresponding Castling-Rights.
+    auto removeRights = [&next](int k)
+    {
+        switch(k)
+        {
+        case 60: next.castling &= ~(CASTLEWHITEKING | CASTLEWHITEQUEEN);   break;
+        case 63: next.castling &= ~CASTLEWHITEKING;                        break;
+        case 56: next.castling &= ~CASTLEWHITEQUEEN;                       break;
+        case 4:  next.castling &= ~(CASTLEBLACKKING | CASTLEBLACKQUEEN);   break;
+        case 7:  next.castling &= ~CASTLEBLACKKING;                        break;
+        case 0:  next.castling &= ~CASTLEBLACKQUEEN;                       break;
+        }
+    };
+    removeRights(start);
+    removeRights(end);
+
+    if(next.enpassant >= 0)
+        next.hash ^= zobristEnPassant[next.enpassant % 8];
+    next.hash ^= zobristCastling[next.castling];
+
+    //Counted like Engine::advanceTurn, which also counts the move that reset the counter.
+    next.turnColour = otherColour;
+    next.hash ^= zobristTurn;
+    next.turnCounter++;
+    next.turnsUntilDrawCounter++;
+
+    return !next.inCheck(l);
+}
+
+bool Position::isLegal(const ChessMove &move) const
+{
+    const PColour l = turnColour;
+    if(l == PNONE)
+        return false;
+
+    const PColour otherColour = (l==PWHITE) ? PBLACK : PWHITE;
+    const int start = move.start.i + 8*move.start.j;
+    const int end = move.end.i + 8*move.end.j;
+    const u64 startKey = bitboardKey[start], endKey = bitboardKey[end];
+    if(!(occupied(l) & startKey))
+        return false;
+
+    const bool isKing = (bitboards[l][KING] & startKey) != 0;
+    if(isKing && abs(move.end.i - move.start.i) == 2 && !canCastle(move.end.i > move.start.i))
+        return false;
+
+    //Remove the captured Piece, including a Pawn captured en-passant, and move the own Piece.
+    u64 pieces[2][6];
+    std::copy(&bitboards[0][0], &bitboards[0][0] + 12, &pieces[0][0]);
+    u64 captured = endKey;
+    if(end == enpassant && (bitboards[l][PAWN] & startKey))
+        captured |= bitboardKey[move.end.i + 8*move.start.j];
+    for(int t=0; t<6; t++)
+        pieces[otherColour][t] &= ~captured;
+
+    if(bitboards[l][KING] == 0)
+        return true;
+
+    const u64 all = (occupied() & ~startKey & ~captured) | endKey;
+    const int kingSquare = isKing ? end : std::countr_zero(bitboards[l][KING]);
+    return !bitboardSquareAttacked(kingSquare, otherColour, pieces, all);
+}
+
+int Position::countLegalMoves() const
+{
+    MoveList moveList;
+    generateMoves(moveList);
+
+    int nLegal = 0;
+    for(const ChessMove &move : moveList)
+        nLegal += isLegal(move);
+    return nLegal;
+}
+
+int Position::getWeight() const
+{
+    if(turnColour == PNONE)
+        return 0;
+
+    if(useNNUE())
+    {
+        NNUE::Accumulator accumulator{};
+        NNUE::refresh(accumulator, bitboards);
+        return getWeight(accumulator);
+    }
+
+    return getHandcraftedWeight(bitboards, isLateGame());
+}
+
+int Position::getWeight(const NNUE::Accumulator &accumulator) const
+{
+    if(turnColour == PNONE)
+        return 0;
+
+    return ((turnColour == PWHITE) ? +1 : -1) * NNUE::evaluate(accumulator, turnColour);
+}
+
 //ChessPiece Functions
 
 void ChessPiece::place(const BoardPos &newpos)
@@ -630,6 +1175,11 @@ char Engine::getPTypeLetter(PType type) const
 }
 
 void Engine::printMove(const ChessMove &move) const
+{
+    std::cout << getMoveString(move);
+}
+
+std::string Engine::getMoveString(const ChessMove &move) const
 {
     const BoardPos start = move.start, end = move.end;
     PType startType;
@@ -644,17 +1194,19 @@ void Engine::printMove(const ChessMove &move) const
 
     const char startLetter = start.i + 'a', endLetter = move.end.i + 'a';
 
+    std::stringstream moveString{};
     if(startType != endType)
-        std::cout << startLetter << 8-start.j << endLetter << 8-end.j << getPTypeLetter(endType);
+        moveString << startLetter << 8-start.j << endLetter << 8-end.j << getPTypeLetter(endType);
     else
-        std::cout << startLetter << 8-start.j << endLetter << 8-end.j;
-    
+        moveString << startLetter << 8-start.j << endLetter << 8-end.j;
+    return moveString.str();
 }
 
 //Saving and Loading the Boardstate
 
 void Engine::saveBoardState(std::size_t position)
 {
+    PROFILE_SCOPE(SAVEBOARDSTATE);
     //Increase size if necessary
     if(position >= boardStateListSize)
     {
@@ -674,6 +1226,9 @@ void Engine::saveBoardState(std::size_t position)
     boardState.checkmateText = checkmateText;
     boardState.drawText = drawText;
 
+    if(useNNUE())
+        boardState.accumulator = accumulator;
+
     //Saving Lists
     for(int l=0; l<2; l++)
     {
@@ -787,10 +1342,15 @@ void Engine::loadBoardState(std::size_t position)
             }
         }
     }
+
+    //The saved Accumulator may stem from a different network or evaluation, so build it anew.
+    if(useNNUE())
+        refreshAccumulator();
 }
 
 void Engine::loadTestBoardState(std::size_t position)
 {
+    PROFILE_SCOPE(LOADTESTBOARDSTATE);
     const BoardState &boardState = boardStateList[position];
 
     //Loading Game Variables
@@ -799,6 +1359,9 @@ void Engine::loadTestBoardState(std::size_t position)
     isdraw = boardState.isdraw;
     lateGame = boardState.lateGame;
 
+    if(useNNUE())
+        accumulator = boardState.accumulator;
+
     //Loading Lists.
     for(int l=0; l<2; l++)
     {
@@ -884,12 +1447,16 @@ void Engine::initialize()
         }
     }
 
+    if(useNNUE())
+        refreshAccumulator();
+
     updateMovement();
     saveBoardState(0);
 }
 
 void Engine::updatePseudoLegalMovement()
 {
+    PROFILE_SCOPE(UPDATEPSEUDOLEGALMOVEMENT);
     for(int l=0; l<2; l++)
     {
         nMovesPseudo[l] = 0;
@@ -904,6 +1471,7 @@ void Engine::updatePseudoLegalMovement()
 
 void Engine::updateLegalMovement()
 {
+    PROFILE_SCOPE(UPDATELEGALMOVEMENT);
     saveBoardState(turnCounter+1);
 
     for(int l=0; l<2; l++)
@@ -974,6 +1542,7 @@ void Engine::checkLateGame()
 
 void Engine::checkGameOver()
 {
+    PROFILE_SCOPE(CHECKGAMEOVER);
     isdraw = false;
 
     if( !kingWhite.alive || !kingBlack.alive )
@@ -1186,6 +1755,7 @@ bool Engine::checkCastlingRights(const ChessMove &move) const
 
 bool Engine::makeMove(const ChessMove &move)
 {
+    PROFILE_SCOPE(MAKEMOVE);
     const BoardPos start = move.start;
     const BoardPos end = move.end;
     ChessPiece *piece = board[start.i][start.j];
@@ -1196,6 +1766,9 @@ bool Engine::makeMove(const ChessMove &move)
         return false;
     }
 
+    if(useNNUE())
+        updateAccumulator(move);
+
     const bool castlingMove = (move.endType == KING && abs(move.end.i-move.start.i)==2);
     bool canCastle;
     if(castlingMove)
@@ -1258,10 +1831,37 @@ void Engine::placeTransformedPawn(const BoardPos &pos, PType type, PColour colou
     }
 }
 
-char Engine::getPieceLetter(const ChessPiece *piece) const
+bool Engine::placePiece(const BoardPos &pos, PType type, PColour colour, bool startOnly)
 {
-    if(piece == nullptr)
-        return ' ';
+    //Index range of the ChessPieces of each type in piecesList.
+    static constexpr int first[6] = {0,1,2,4,6,8};
+    static constexpr int last[6]  = {0,1,3,5,7,15};
+
+    for(int k=first[type]; k<=last[type]; k++)
+    {
+        ChessPiece *piece = piecesList[colour][k];
+        const bool startsHere = (piece->startPos.i == pos.i && piece->startPos.j == pos.j);
+        if(!piece->alive && (startsHere || !startOnly))
+        {
+            piece->place(pos);
+            return true;
+        }
+    }
+
+    if(startOnly)
+        return false;
+
+    if(type == KING)
+        piecesList[colour][KING]->place(pos);
+    else if(type != PAWN)
+        placeTransformedPawn(pos, type, colour);
+    return true;
+}
+
+char Engine::getPieceLetter(const ChessPiece *piece) const
+{
+    if(piece == nullptr)
+        return ' ';
 
     const PType type = piece->type;
     const PColour colour = piece->colour;
@@ -1601,6 +2201,217 @@ void Engine::loadFEN(const char *FEN)
         maxTurns = turnCounter;
     }
 
+    if(useNNUE())
+        refreshAccumulator();
+
+    updatePseudoLegalMovement();
+}
+
+void Engine::copyPosition(const Engine &source)
+{
+    //The pointers of source have to be replaced by the corresponding ChessPieces of this Engine.
+    auto translate = [this, &source](const ChessPiece *piece) -> ChessPiece*
+    {
+        if(piece == nullptr)
+            return nullptr;
+
+        const int l = piece->colour;
+        for(int k=0; k<nPieces; k++)
+        {
+            if(source.piecesList[l][k] == piece)
+                return piecesList[l][k];
+        }
+        return nullptr;
+    };
+
+    //General Game Variables
+    turnCounter = source.turnCounter;
+    turnCounterStart = source.turnCounterStart;
+    turnsUntilDrawCounter = source.turnsUntilDrawCounter;
+    maxTurns = source.maxTurns;
+    isdraw = source.isdraw;
+    lateGame = source.lateGame;
+    requestDraw = source.requestDraw;
+    turnColour = source.turnColour;
+    turnColourOld = source.turnColourOld;
+    checkmateText = source.checkmateText;
+    drawText = source.drawText;
+
+    for(int l=0; l<2; l++)
+    {
+        checkmate[l] = source.checkmate[l];
+        nAlive[l] = source.nAlive[l];
+        nAvailable[l] = source.nAvailable[l];
+        nMovesLegal[l] = source.nMovesLegal[l];
+        nMovesPseudo[l] = source.nMovesPseudo[l];
+        dangerZone[l] = source.dangerZone[l];
+        attackZone[l] = source.attackZone[l];
+
+        std::copy(source.moveListLegal[l], source.moveListLegal[l] + nMovesLegal[l], moveListLegal[l]);
+        std::copy(source.moveListPseudo[l], source.moveListPseudo[l] + nMovesPseudo[l], moveListPseudo[l]);
+
+        for(int k=0; k<nPieces; k++)
+        {
+            piecesListAlive[l][k] = translate(source.piecesListAlive[l][k]);
+            piecesListAvailable[l][k] = translate(source.piecesListAvailable[l][k]);
+
+            //ChessPiece Variables
+            const ChessPiece *from = source.piecesList[l][k];
+            ChessPiece *to = piecesList[l][k];
+
+            to->type = from->type;
+            to->alive = from->alive;
+            to->moved = from->moved;
+            to->enpassant = from->enpassant;
+            to->transformed = from->transformed;
+            to->pos = from->pos;
+            to->movement = from->movement;
+            to->movementPseudo = from->movementPseudo;
+            to->nMoves = from->nMoves;
+            to->nMovesPseudo = from->nMovesPseudo;
+            std::copy(from->moveList, from->moveList + from->nMoves, to->moveList);
+            std::copy(from->moveListPseudo, from->moveListPseudo + from->nMovesPseudo, to->moveListPseudo);
+        }
+    }
+
+    //Chessboard
+    for(int i=0; i<8; i++)
+    {
+        for(int j=0; j<8; j++)
+            board[i][j] = translate(source.board[i][j]);
+    }
+
+    if(useNNUE())
+        accumulator = source.accumulator;
+}
+
+Position Engine::getPosition() const
+{
+    Position position{};
+    getPieceBitboards(position.bitboards);
+    position.turnColour = turnColour;
+    position.turnCounter = (std::uint32_t)turnCounter;
+    position.turnsUntilDrawCounter = (std::uint16_t)turnsUntilDrawCounter;
+
+    //Castling is possible as long as the King and the Rook on the corner have not moved, the same condition KingPseudoLegal checks.
+    auto unmoved = [this](int i, int j, PType type, PColour colour)
+    {
+        const ChessPiece *piece = board[i][j];
+        return piece != nullptr && piece->type == type && piece->colour == colour && !piece->moved;
+    };
+
+    for(int l=0; l<2; l++)
+    {
+        const PColour colour = (PColour)l;
+        const int j = (colour==PWHITE) ? 7 : 0;
+        if(!unmoved(4, j, KING, colour))
+            continue;
+
+        if(unmoved(7, j, ROOK, colour))
+            position.castling |= (colour==PWHITE) ? CASTLEWHITEKING : CASTLEBLACKKING;
+        if(unmoved(0, j, ROOK, colour))
+            position.castling |= (colour==PWHITE) ? CASTLEWHITEQUEEN : CASTLEBLACKQUEEN;
+    }
+
+    //en-passant: The square behind a Pawn of the other colour that just moved two squares.
+    if(turnColour != PNONE)
+    {
+        const int l = (turnColour == PWHITE) ? PBLACK : PWHITE;
+        for(int k=8; k<nPieces; k++)
+        {
+            const ChessPiece *pawn = piecesList[l][k];
+            if(pawn->alive && pawn->type == PAWN && pawn->enpassant)
+            {
+                const int sign = (l==PWHITE) ? +1 : -1;
+                position.enpassant = (std::int8_t)(pawn->pos.i + 8*(pawn->pos.j + sign));
+                break;
+            }
+        }
+    }
+
+    position.hash = position.computeHash();
+    return position;
+}
+
+void Engine::loadPosition(const Position &position)
+{
+    //Mark Pieces as dead until placed on their new position.
+    for(int l=0; l<2; l++)
+    {
+        for(int k=0; k<nPieces; k++)
+        {
+            piecesList[l][k]->kill();
+        }
+    }
+
+    //First place the Pieces that stand on the start square of a ChessPiece of their type, so the Kings and Rooks are the ones getFEN checks for castling.
+    //The others are placed in the same order as loadFEN.
+    u64 placed = 0;
+    for(int k=0; k<64; k++)
+    {
+        PColour colour{};
+        PType type{};
+        if(position.getPiece(k, colour, type) && placePiece({k%8, k/8}, type, colour, true))
+            placed |= bitboardKey[k];
+    }
+
+    for(int k=0; k<64; k++)
+    {
+        PColour colour{};
+        PType type{};
+        if(!(placed & bitboardKey[k]) && position.getPiece(k, colour, type))
+            placePiece({k%8, k/8}, type, colour);
+    }
+
+    //Castling: Only the King and the Rooks on the corners of a Castling-Right count as unmoved.
+    for(int l=0; l<2; l++)
+    {
+        for(int k=0; k<nPieces; k++)
+        {
+            ChessPiece *piece = piecesList[l][k];
+            if(piece->type == KING || piece->type == ROOK)
+                piece->moved = true;
+        }
+    }
+
+    auto allowCastling = [this](int i, int j)
+    {
+        ChessPiece *king = board[4][j], *rook = board[i][j];
+        if(king != nullptr && rook != nullptr)
+        {
+            king->moved = false;
+            rook->moved = false;
+        }
+    };
+
+    if(position.castling & CASTLEWHITEKING)
+        allowCastling(7, 7);
+    if(position.castling & CASTLEWHITEQUEEN)
+        allowCastling(0, 7);
+    if(position.castling & CASTLEBLACKKING)
+        allowCastling(7, 0);
+    if(position.castling & CASTLEBLACKQUEEN)
+        allowCastling(0, 0);
+
+    //en passant
+    if(position.enpassant >= 0)
+    {
+        const int i = position.enpassant % 8;
+        const int j = position.enpassant / 8;
+        ChessPiece *pawn = board[i][(j==2) ? 3 : 4];
+        if(pawn != nullptr && pawn->type == PAWN)
+            pawn->enpassant = true;
+    }
+
+    turnColour = position.turnColour;
+    turnCounter = position.turnCounter;
+    turnCounterStart = turnCounter;
+    maxTurns = turnCounter;
+    turnsUntilDrawCounter = position.turnsUntilDrawCounter;
+
+    if(useNNUE())
+        refreshAccumulator();
+
     updatePseudoLegalMovement();
 }
 
@@ -1730,6 +2541,7 @@ int Engine::getPositionWeight(const BoardPos &pos, PType type, PColour colour) c
 
 int Engine::getBoardWeight() const
 {
+    PROFILE_SCOPE(GETBOARDWEIGHT);
     if(turnColour == PNONE)
     {
         if(checkmate[PWHITE])
@@ -1740,103 +2552,79 @@ int Engine::getBoardWeight() const
             return 0;
     }
 
-    int weight = 0;
+    if(useNNUE())
+        return ((turnColour == PWHITE) ? +1 : -1) * NNUE::evaluate(accumulator, turnColour);
+
+    u64 bitboards[2][6]{};
+    getPieceBitboards(bitboards);
+    return getHandcraftedWeight(bitboards, lateGame);
+}
 
+void Engine::getPieceBitboards(u64 bitboards[2][6]) const
+{
     for(int l=0; l<2; l++)
     {
-        const int sign = ((l==PWHITE) ? +1 : -1);
+        for(int t=0; t<6; t++)
+            bitboards[l][t] = 0;
 
         for(int k=0; k<nPieces; k++)
         {
             const ChessPiece *piece = piecesList[l][k];
             if(piece->alive)
-            {
-                //Add the PST- and piece-values.
-                weight += sign * ( getPositionWeight(piece->pos, piece->type, piece->colour) + pieceValue[lateGame][piece->type] );
-
-                if(piece->type == PAWN)
-                {
-                    //Blocked Pawn
-                    if(piece->nMovesPseudo == 0)
-                        weight += sign * PawnBlocked[lateGame];
-
-                    //Doubled and Isolated Pawns.
-                    const int iPiece = piece->pos.i;
-                    int nPawnsCenter = 0;
-                    bool coverLeft = false, coverRight = false;
-                    for(int j=1; j<7; j++)
-                    {
-                        if(!coverLeft && iPiece > 0)
-                        {
-                            const ChessPiece *leftPiece = board[iPiece-1][j];
-                            coverLeft = (leftPiece != nullptr && leftPiece->type == PAWN && leftPiece->colour == piece->colour);
-                        }
-
-                        if(!coverRight && iPiece < 7)
-                        {
-                            const ChessPiece *rightPiece = board[iPiece+1][j];
-                            coverRight = (rightPiece != nullptr && rightPiece->type == PAWN && rightPiece->colour == piece->colour);
-                        }
-
-                        const ChessPiece *centerPiece = board[iPiece][j];
-                        if(centerPiece != nullptr && centerPiece->type == PAWN && centerPiece->colour == piece->colour)
-                            ++nPawnsCenter;
-                    }
-
-                    weight += sign * ( (nPawnsCenter-1) * PawnDoubled[lateGame] + (!coverLeft && !coverRight) * PawnIsolated[lateGame] );
-
-                }
-                else
-                {
-                    //Add mobility score
-                    const int nMoves = piece->nMovesPseudo;
-                    switch(piece->type)
-                    {
-                    case KING:
-                        weight += sign * KingMobility[lateGame][nMoves];
-                        break;
+                bitboards[l][piece->type] |= bitboardKey[piece->pos.i + (8*piece->pos.j)];
+        }
+    }
+}
 
-                    case QUEEN:
-                        weight += sign * QueenMobility[lateGame][nMoves];
-                        break;
+void Engine::refreshAccumulator()
+{
+    u64 bitboards[2][6]{};
+    getPieceBitboards(bitboards);
+    NNUE::refresh(accumulator, bitboards);
+}
 
-                    case BISHOP:
-                        weight += sign * BishopMobility[lateGame][nMoves];
-                        break;
+void Engine::updateAccumulator(const ChessMove &move)
+{
+    const BoardPos start = move.start;
+    const BoardPos end = move.end;
+    const ChessPiece *piece = board[start.i][start.j];
+    if(piece == nullptr)
+        return;
 
-                    case KNIGHT:
-                        weight += sign * KnightMobility[lateGame][nMoves];
-                        break;
+    const ChessPiece *capturedPiece = board[end.i][end.j];
 
-                    case ROOK:
-                        weight += sign * RookMobility[lateGame][nMoves];
-                        break;
+    //Normal Capture
+    if(capturedPiece != nullptr)
+        NNUE::removePiece(accumulator, capturedPiece->colour, capturedPiece->type, end.i + 8*end.j);
 
-                    case PAWN:
-                        break;
-                    }
-                }
-            }
-        }
+    //En passant
+    else if(piece->type == PAWN && start.i != end.i)
+    {
+        const ChessPiece *enpassantPiece = board[end.i][start.j];
+        if(enpassantPiece != nullptr)
+            NNUE::removePiece(accumulator, enpassantPiece->colour, enpassantPiece->type, end.i + 8*start.j);
+    }
 
-        //Add a penalty if the king is in check.
-        if(piecesList[l][KING]->checkCheck())
-            weight += sign*KingCheck[lateGame];
+    //Castling
+    if(piece->type == KING && abs(end.i - start.i) == 2)
+    {
+        const int rook_i = (end.i < start.i) ? 0 : 7;
+        const int rookEnd_i = (end.i < start.i) ? 3 : 5;
+        NNUE::removePiece(accumulator, piece->colour, ROOK, rook_i + 8*start.j);
+        NNUE::addPiece(accumulator, piece->colour, ROOK, rookEnd_i + 8*start.j);
     }
 
-    return weight;
+    //Move the Piece itself. endType differs from type for Pawn-Transforms.
+    NNUE::removePiece(accumulator, piece->colour, piece->type, start.i + 8*start.j);
+    NNUE::addPiece(accumulator, piece->colour, move.endType, end.i + 8*end.j);
 }
 
-int Engine::getMoveWeight(int depth, const ChessMove &move) const
+int Engine::getMoveWeight(int depth, const ChessMove &move, SearchContext &context) const
 {
     //Load the Testengine to do the search on.
-    auto engine = std::make_unique<Engine>();
-    engine->loadFEN( getFEN().c_str() );
-    engine->turnCounter = 0;
-    engine->turnCounterStart = 0;
-    engine->saveBoardState(0);
+    context.loadPosition(*this);
 
-    return negamax(depth, 1, -INT_MAX, +INT_MAX, {move}, engine);
+    return negamax(depth, 1, -INT_MAX, +INT_MAX, {move}, context);
 }
 
 void Engine::advancePseudoTurn()
@@ -1855,75 +2643,237 @@ void Engine::advancePseudoTurn()
 void Chess::initialize()
 {
     bitboardInitializeKeys();
+    bitboardInitializeMasks();
+    bitboardInitializeAttacks();
+    zobristInitializeKeys();
+    threadPool.start(nThreads);
+    perftTable.resize(16);
     mainEngine.initialize();
-    std::cout << "INFO: Chess Engine loaded.\n";
+    std::cout << "INFO: Chess Engine loaded. Threads: " << threadPool.topology() << ".\n";
+}
+
+bool Chess::useNNUE()
+{
+    return evalType == NNUEEVAL && NNUE::loaded;
 }
 
 //Threads
 
-void Chess::cleanUpThreads()
+void Chess::stopAllThreads()
 {
-    const int nThreads = (int)threadList.size();
-    if(nThreads <= 0)
-        return;
-    for(int i = nThreads-1; i>=0; i--)
+    globalToken.cancel();
+    threadPool.waitIdle();
+    globalToken.reset();
+}
+
+//Weight Calculations
+
+//Add value counted count times to weight and pass the term on to sink.
+static void addTerm(int &weight, const int &value, int count, EvalSink *sink)
+{
+    weight += count * value;
+    if(sink != nullptr && count != 0)
+        sink->add(value, count);
+}
+
+int Chess::getPieceWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink)
+{
+    //Same as summing getPositionWeight and pieceValue over all alive pieces.
+    static constexpr const int (*PST[6])[8][8] = {KingPST, QueenPST, BishopPST, KnightPST, RookPST, PawnPST};
+
+    int weight = 0;
+
+    for(int l=0; l<2; l++)
     {
-        if(threadDone[i])
+        const int sign = ((l==PWHITE) ? +1 : -1);
+
+        for(int t=0; t<6; t++)
         {
-            //Join the thread if necessary.
-            if(threadList[i].joinable())
-                threadList[i].join();
+            u64 pieces = bitboards[l][t];
+            while(pieces)
+            {
+                const int k = std::countr_zero(pieces);
+                pieces &= pieces - 1;
 
-            //Erase them from the list.
-            threadList.erase(threadList.begin() + i);
-            threadDone.erase(threadDone.begin() + i);
+                //For Black, the PST-Matrix must be mirrored.
+                const int i = (l==PWHITE) ? k/8 : 7-k/8;
+                addTerm(weight, PST[t][lateGame][i][k%8], sign, sink);
+                addTerm(weight, pieceValue[lateGame][t], sign, sink);
+            }
         }
     }
+
+    return weight;
 }
 
-void Chess::stopAllThreads()
+int Chess::getPawnWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink)
 {
-    stopThread.store(true);
-    for(auto &thread : threadList)
+    int weight = 0;
+
+    u64 occupied = 0, occupiedColour[2] = {0,0};
+    for(int l=0; l<2; l++)
+    {
+        for(int t=0; t<6; t++)
+            occupiedColour[l] |= bitboards[l][t];
+        occupied |= occupiedColour[l];
+    }
+
+    for(int l=0; l<2; l++)
     {
-        if(thread.joinable())
-            thread.join();
+        const int sign = ((l==PWHITE) ? +1 : -1);
+        const PColour colour = (PColour)l;
+        const PColour enemyColour = (l==PWHITE) ? PBLACK : PWHITE;
+        const u64 pawns = bitboards[l][PAWN];
+        const u64 enemyPawns = bitboards[enemyColour][PAWN];
+
+        //Doubled Pawns: Every Pawn is penalized once for each other friendly Pawn on its file.
+        //Pawns d rows apart on the same file are found by shifting d*8 bits. Each pair is counted once, thus times two.
+        int nPairs = 0;
+        for(int d=1; d<6; d++)
+            nPairs += bitboardCount(pawns & (pawns >> (8*d)));
+        addTerm(weight, PawnDoubled[lateGame], sign * 2*nPairs, sink);
+
+        //Isolated Pawns: No friendly Pawns on the neighbouring files.
+        const u64 files = bitboardFillForward(pawns, colour) | bitboardFillBackward(pawns, colour);
+        const u64 isolated = pawns & ~(bitboardShiftLeft(files) | bitboardShiftRight(files));
+        addTerm(weight, PawnIsolated[lateGame], sign * bitboardCount(isolated), sink);
+
+        //Blocked Pawns: The square in front is occupied and there is nothing to capture. En passant is ignored.
+        const u64 pushBlocked = bitboardShiftBackward(bitboardShiftForward(pawns, colour) & occupied, colour);
+        const u64 canCaptureLeft  = bitboardShiftRight(bitboardShiftBackward(bitboardShiftForward(bitboardShiftLeft(pawns), colour) & occupiedColour[enemyColour], colour));
+        const u64 canCaptureRight = bitboardShiftLeft(bitboardShiftBackward(bitboardShiftForward(bitboardShiftRight(pawns), colour) & occupiedColour[enemyColour], colour));
+        const u64 blocked = pushBlocked & ~(canCaptureLeft | canCaptureRight);
+        addTerm(weight, PawnBlocked[lateGame], sign * bitboardCount(blocked), sink);
+
+        //Backward Pawns: The stop-square is attacked by an enemy Pawn and no friendly Pawn can ever cover it.
+        const u64 attackSpan = bitboardFillForward(bitboardPawnAttacks(pawns, colour), colour);
+        const u64 stops = bitboardShiftForward(pawns, colour);
+        const u64 backward = bitboardShiftBackward(stops & bitboardPawnAttacks(enemyPawns, enemyColour) & ~attackSpan, colour);
+        addTerm(weight, PawnBackward[lateGame], sign * bitboardCount(backward), sink);
+
+        //Passed Pawns: No enemy Pawn in front of it on its own or the neighbouring files.
+        const u64 enemyFront = bitboardFillForward(bitboardShiftForward(enemyPawns, enemyColour), enemyColour);
+        const u64 passed = pawns & ~(enemyFront | bitboardShiftLeft(enemyFront) | bitboardShiftRight(enemyFront));
+        if(passed)
+        {
+            for(int rank=1; rank<7; rank++)
+            {
+                const int j = (l==PWHITE) ? 7-rank : rank;
+                addTerm(weight, PawnPassed[lateGame][rank], sign * bitboardCount(passed & bitboardRow[j]), sink);
+            }
+        }
     }
-    threadList.clear();
-    stopThread.store(false);
+
+    return weight;
 }
 
-//Weight Calculations
+int Chess::getMobilityWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink)
+{
+    int weight = 0;
+
+    u64 occupied = 0, occupiedColour[2] = {0,0};
+    for(int l=0; l<2; l++)
+    {
+        for(int t=0; t<6; t++)
+            occupiedColour[l] |= bitboards[l][t];
+        occupied |= occupiedColour[l];
+    }
+
+    for(int l=0; l<2; l++)
+    {
+        const int sign = ((l==PWHITE) ? +1 : -1);
+        const PColour enemyColour = (l==PWHITE) ? PBLACK : PWHITE;
+
+        //Mobility-Area: Squares not occupied by friendly Pieces and not attacked by enemy Pawns.
+        const u64 mobilityArea = ~occupiedColour[l] & ~bitboardPawnAttacks(bitboards[enemyColour][PAWN], enemyColour);
 
-int Chess::negamax(int depth, int saveCounter, int alpha, int beta, const std::vector<ChessMove> &moveList, std::unique_ptr<Engine> &engine)
+        for(int t=KING; t<PAWN; t++)
+        {
+            u64 pieces = bitboards[l][t];
+            while(pieces)
+            {
+                const int k = std::countr_zero(pieces);
+                pieces &= pieces - 1;
+
+                switch(t)
+                {
+                case KING:
+                    addTerm(weight, KingMobility[lateGame][bitboardCount(bitboardKingAttacks[k] & mobilityArea)], sign, sink);
+                    break;
+
+                case QUEEN:
+                    addTerm(weight, QueenMobility[lateGame][bitboardCount((bitboardRookAttacks(k, occupied) | bitboardBishopAttacks(k, occupied)) & mobilityArea)], sign, sink);
+                    break;
+
+                case BISHOP:
+                    addTerm(weight, BishopMobility[lateGame][bitboardCount(bitboardBishopAttacks(k, occupied) & mobilityArea)], sign, sink);
+                    break;
+
+                case KNIGHT:
+                    addTerm(weight, KnightMobility[lateGame][bitboardCount(bitboardKnightAttacks[k] & mobilityArea)], sign, sink);
+                    break;
+
+                case ROOK:
+                    addTerm(weight, RookMobility[lateGame][bitboardCount(bitboardRookAttacks(k, occupied) & mobilityArea)], sign, sink);
+                    break;
+                }
+            }
+        }
+
+        //Add a penalty if the king is in check.
+        const u64 king = bitboards[l][KING];
+        if(king && bitboardSquareAttacked(std::countr_zero(king), enemyColour, bitboards, occupied))
+            addTerm(weight, KingCheck[lateGame], sign, sink);
+    }
+
+    return weight;
+}
+
+int Chess::getHandcraftedWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink)
+{
+    return getPieceWeight(bitboards, lateGame, sink) + getPawnWeight(bitboards, lateGame, sink) + getMobilityWeight(bitboards, lateGame, sink);
+}
+
+int Chess::negamax(int depth, int saveCounter, int alpha, int beta, const MoveList &moveList, SearchContext &context)
 {
-    const int sign = ((engine->turnColour == PWHITE) ? +1 : -1);
+    PROFILE_SCOPE(NEGAMAX);
+    Engine *engine = context.engine.get();
+    const PColour colour = engine->turnColour;
+    const int sign = ((colour == PWHITE) ? +1 : -1);
+    SEARCH_STATS(context.stats.nodes[std::min(saveCounter, SearchStats::maxPly)]++);
 
-    if(depth<=0 || stopThread.load() || engine->turnColour == PNONE)
+    if(depth<=0 || context.counter.poll() || engine->turnColour == PNONE)
+    {
+        SEARCH_STATS(context.stats.leafNodes++);
         return sign*engine->getBoardWeight();
+    }
 
     engine->saveBoardState(engine->turnCounter + saveCounter);
 
     int max = -INT_MAX;
     const PColour nextTurnColour = ((engine->turnColour == PWHITE) ? PBLACK : PWHITE);
     int legalMoveFound = false;
+    SEARCH_STATS(int nSearched = 0);
 
     for(const ChessMove &move : moveList)
     {
-        if(stopThread.load())
+        if(context.counter.isStopped())
             return max;
 
+        const bool isCapture = (engine->board[move.end.i][move.end.j] != nullptr);
         const bool isLegal = engine->makeMove(move);
 
         if(isLegal)
         {
             legalMoveFound = true;
+            SEARCH_STATS(nSearched++);
             engine->advancePseudoTurn();
 
-            std::vector<ChessMove> newMoveList{};
-            newMoveList.assign(engine->moveListPseudo[nextTurnColour], engine->moveListPseudo[nextTurnColour] + engine->nMovesPseudo[nextTurnColour]);
+            MoveList newMoveList(engine->moveListPseudo[nextTurnColour], engine->moveListPseudo[nextTurnColour] + engine->nMovesPseudo[nextTurnColour]);
+            if(depth > 1)
+                context.orderMoves(newMoveList, saveCounter+1);
 
-            const int weight = -negamax(depth-1, saveCounter+1, -beta, -alpha, newMoveList, engine);
+            const int weight = -negamax(depth-1, saveCounter+1, -beta, -alpha, newMoveList, context);
 
             if(weight > max)
             {
@@ -1933,7 +2883,12 @@ int Chess::negamax(int depth, int saveCounter, int alpha, int beta, const std::v
             }
 
             if(weight >= beta)
+            {
+                SEARCH_STATS(context.stats.cutoffs++, context.stats.firstMoveCutoffs += (nSearched == 1));
+                if(!isCapture)
+                    context.storeCutoff(move, colour, saveCounter, depth);
                 return weight;
+            }
         }
 
         engine->loadTestBoardState(engine->turnCounter + saveCounter);
@@ -1946,13 +2901,330 @@ int Chess::negamax(int depth, int saveCounter, int alpha, int beta, const std::v
         return max;
 }
 
+int Chess::negamax(int depth, int ply, int alpha, int beta, const Position &position, SearchContext &context, const NNUE::Accumulator *accumulator)
+{
+    //With NNUE the Accumulator is built once and then updated by the pieces that moved, instead of being rebuilt at every leaf.
+    if(accumulator == nullptr && useNNUE())
+    {
+        NNUE::Accumulator rootAccumulator{};
+        NNUE::refresh(rootAccumulator, position.bitboards);
+        return negamax(depth, ply, alpha, beta, position, context, &rootAccumulator);
+    }
+
+    PROFILE_SCOPE(NEGAMAX);
+    const PColour colour = position.turnColour;
+    const int sign = ((colour == PWHITE) ? +1 : -1);
+    SEARCH_STATS(context.stats.nodes[std::min(ply, SearchStats::maxPly)]++);
+
+    if(depth<=0 || context.counter.poll() || colour == PNONE)
+    {
+        SEARCH_STATS(context.stats.leafNodes++);
+        return sign*((accumulator != nullptr) ? position.getWeight(*accumulator) : position.getWeight());
+    }
+
+    MoveList moveList;
+    position.generateMoves(moveList);
+    context.orderMoves(moveList, ply, position);
+
+    int max = -INT_MAX;
+    bool legalMoveFound = false;
+    SEARCH_STATS(int nSearched = 0);
+    const u64 occupied = position.occupied();
+
+    for(const ChessMove &move : moveList)
+    {
+        if(context.counter.isStopped())
+            return max;
+
+        //The next Position is written into a copy, so there is nothing to undo.
+        Position next;
+        if(!position.makeMove(move, next))
+            continue;
+
+        legalMoveFound = true;
+        SEARCH_STATS(nSearched++);
+        const bool isCapture = (occupied & bitboardKey[move.end.i + 8*move.end.j]) != 0;
+        int weight = 0;
+        if(accumulator != nullptr)
+        {
+            NNUE::Accumulator nextAccumulator = *accumulator;
+            NNUE::update(nextAccumulator, position.bitboards, next.bitboards);
+            weight = -negamax(depth-1, ply+1, -beta, -alpha, next, context, &nextAccumulator);
+        }
+        else
+            weight = -negamax(depth-1, ply+1, -beta, -alpha, next, context);
+
+        if(weight > max)
+        {
+            max = weight;
+            if(weight > alpha)
+                alpha = weight;
+        }
+
+        if(weight >= beta)
+        {
+            SEARCH_STATS(context.stats.cutoffs++, context.stats.firstMoveCutoffs += (nSearched == 1));
+            if(!isCapture)
+                context.storeCutoff(move, colour, ply, depth);
+            return weight;
+        }
+    }
+
+    //If there is a Draw
+    if(!legalMoveFound && !position.inCheck(colour))
+        return 0;
+    else
+        return max;
+}
+
+//EnginePool-Functions
+
+void EnginePool::Recycler::operator()(Engine *engine) const
+{
+    const std::unique_lock<std::mutex> lock = Trace::lock(enginePool.mtx, "enginePool");
+    enginePool.engines.emplace_back(engine);
+}
+
+EnginePool::Handle EnginePool::acquire()
+{
+    {
+        const std::unique_lock<std::mutex> lock = Trace::lock(mtx, "enginePool");
+        if(!engines.empty())
+        {
+            Handle engine{engines.back().release()};
+            engines.pop_back();
+            return engine;
+        }
+    }
+
+    Handle engine{new Engine()};
+    engine->initialize();
+    return engine;
+}
+
+void EnginePool::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    engines.clear();
+}
+
+std::size_t EnginePool::size()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return engines.size();
+}
+
+//PerftTable-Functions
+
+void PerftTable::resize(std::size_t sizeMB)
+{
+    std::size_t n = 0;
+    if(sizeMB > 0)
+        n = std::bit_floor(sizeMB * 1024 * 1024 / sizeof(Entry));
+
+    entries.reset(n > 0 ? new Entry[n] : nullptr);
+    nEntries = n;
+}
+
+void PerftTable::clear()
+{
+    for(std::size_t n=0; n<nEntries; n++)
+    {
+        entries[n].key.store(0, std::memory_order_relaxed);
+        entries[n].nodes.store(0, std::memory_order_relaxed);
+    }
+}
+
+u64 PerftTable::entryKey(u64 hash, int depth)
+{
+    return hash ^ ((u64)depth * 0x9E3779B97F4A7C15ULL);
+}
+
+bool PerftTable::probe(u64 hash, int depth, u64 &nodes) const
+{
+    if(nEntries == 0)
+        return false;
+
+    const u64 key = entryKey(hash, depth);
+    const Entry &entry = entries[key & (nEntries - 1)];
+    const u64 storedKey = entry.key.load(std::memory_order_relaxed);
+    const u64 storedNodes = entry.nodes.load(std::memory_order_relaxed);
+    if((storedKey ^ storedNodes) != key || storedNodes == 0)
+        return false;
+
+    nodes = storedNodes;
+    return true;
+}
+
+void PerftTable::store(u64 hash, int depth, u64 nodes)
+{
+    if(nEntries == 0)
+        return;
+
+    const u64 key = entryKey(hash, depth);
+    Entry &entry = entries[key & (nEntries - 1)];
+    entry.key.store(key ^ nodes, std::memory_order_relaxed);
+    entry.nodes.store(nodes, std::memory_order_relaxed);
+}
+
+std::size_t PerftTable::sizeMB() const
+{
+    return nEntries * sizeof(Entry) / (1024 * 1024);
+}
+
+//SearchStats-Functions
+
+void SearchStats::add(const SearchStats &other)
+{
+    for(int ply=0; ply<=maxPly; ply++)
+        nodes[ply] += other.nodes[ply];
+    leafNodes += other.leafNodes;
+    cutoffs += other.cutoffs;
+    firstMoveCutoffs += other.firstMoveCutoffs;
+}
+
+void SearchStats::print(std::ostream &out) const
+{
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed;
+    out.precision(2);
+
+    //The root itself is a single node at ply 0.
+    u64 totalNodes = 0;
+    int lastPly = 0;
+    for(int ply=1; ply<=maxPly; ply++)
+    {
+        if(nodes[ply] == 0)
+            continue;
+
+        const u64 previous = (ply == 1) ? 1 : nodes[ply-1];
+        out << "info string ply " << ply << ": " << nodes[ply] << " nodes, branching factor " << (previous > 0 ? (double)nodes[ply] / previous : 0.0) << '\n';
+        totalNodes += nodes[ply];
+        lastPly = ply;
+    }
+
+    const u64 interiorNodes = totalNodes - leafNodes;
+    out << "info string effective branching factor " << (lastPly > 0 ? std::pow((double)nodes[lastPly], 1.0 / lastPly) : 0.0) << '\n';
+    out << "info string fail-high rate " << (interiorNodes > 0 ? 100.0 * cutoffs / interiorNodes : 0.0) << "% of " << interiorNodes << " interior nodes, "
+        << "first move " << (cutoffs > 0 ? 100.0 * firstMoveCutoffs / cutoffs : 0.0) << "% of " << cutoffs << " cutoffs\n";
+    out << "info string leaf nodes " << (totalNodes > 0 ? 100.0 * leafNodes / totalNodes : 0.0) << "% of " << totalNodes << " nodes\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+//SearchContext-Functions
+
+void SearchContext::loadPosition(const Engine &source)
+{
+    if(!engine)
+        engine = enginePool.acquire();
+
+    engine->copyPosition(source);
+    engine->turnCounter = 0;
+    engine->turnCounterStart = 0;
+    engine->saveBoardState(0);
+    arena.reset();
+}
+
+void SearchContext::orderMoves(MoveList &moveList, int ply)
+{
+    const Arena::Scope scope{arena};
+    const int nMoves = moveList.size();
+    int *captureValues = arena.allocate<int>(nMoves);
+    const bool lateGame = engine->lateGame;
+    for(int m=0; m<nMoves; m++)
+    {
+        const ChessPiece *target = engine->board[moveList[m].end.i][moveList[m].end.j];
+        captureValues[m] = (target != nullptr) ? pieceValue[lateGame][target->type] : -1;
+    }
+
+    const PColour colour = (engine->turnColour == PBLACK) ? PBLACK : PWHITE;
+    sortMoves(moveList.data(), nMoves, captureValues, colour, ply);
+}
+
+void SearchContext::orderMoves(MoveList &moveList, int ply, const Position &position)
+{
+    const Arena::Scope scope{arena};
+    const int nMoves = moveList.size();
+    int *captureValues = arena.allocate<int>(nMoves);
+    const bool lateGame = position.isLateGame();
+    for(int m=0; m<nMoves; m++)
+    {
+        PColour colour{};
+        PType type{};
+        const bool isCapture = position.getPiece(moveList[m].end.i + 8*moveList[m].end.j, colour, type);
+        captureValues[m] = isCapture ? pieceValue[lateGame][type] : -1;
+    }
+
+    const PColour colour = (position.turnColour == PBLACK) ? PBLACK : PWHITE;
+    sortMoves(moveList.data(), nMoves, captureValues, colour, ply);
+}
+
+void SearchContext::sortMoves(ChessMove *moveList, int nMoves, const int *captureValues, PColour colour, int ply)
+{
+    const Arena::Scope scope{arena};
+    auto sameMove = [](const ChessMove &a, const ChessMove &b)
+    {
+        return a.start.i == b.start.i && a.start.j == b.start.j && a.end.i == b.end.i && a.end.j == b.end.j && a.endType == b.endType;
+    };
+
+    ply = std::min(ply, maxPly-1);
+
+    int *scores = arena.allocate<int>(nMoves);
+    for(int m=0; m<nMoves; m++)
+    {
+        const ChessMove &move = moveList[m];
+
+        if(captureValues[m] >= 0)
+            scores[m] = 1'100'000'000 + captureValues[m];
+        else if(sameMove(move, killers[ply][0]))
+            scores[m] = 1'000'000'001;
+        else if(sameMove(move, killers[ply][1]))
+            scores[m] = 1'000'000'000;
+        else
+            scores[m] = history[colour][move.start.i + 8*move.start.j][move.end.i + 8*move.end.j];
+    }
+
+    //Insertion sort, since the lists are short. Keeps the generated order for equal scores.
+    for(int m=1; m<nMoves; m++)
+    {
+        const ChessMove move = moveList[m];
+        const int score = scores[m];
+        int n = m-1;
+        while(n >= 0 && scores[n] < score)
+        {
+            moveList[n+1] = moveList[n];
+            scores[n+1] = scores[n];
+            n--;
+        }
+        moveList[n+1] = move;
+        scores[n+1] = score;
+    }
+}
+
+void SearchContext::storeCutoff(const ChessMove &move, PColour colour, int ply, int depth)
+{
+    if(ply >= maxPly)
+        return;
+
+    const ChessMove &killer = killers[ply][0];
+    if(killer.start.i != move.start.i || killer.start.j != move.start.j || killer.end.i != move.end.i || killer.end.j != move.end.j || killer.endType != move.endType)
+    {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = move;
+    }
+
+    int &bonus = history[colour][move.start.i + 8*move.start.j][move.end.i + 8*move.end.j];
+    bonus = std::min(bonus + depth*depth, 1'000'000);
+}
+
 //Bot-Functions
 
 void Bot::updateThreadSize()
 {
     nThreadsBot = nThreads;
-    nextMoveList.resize(nThreads);
-    nextMoveWeightList.resize(nThreads);
 }
 
 void Bot::executeMove() const
@@ -1964,97 +3236,205 @@ void Bot::executeMove() const
         std::cerr << "ERROR Bot: Generated illegal move!";
 }
 
+MoveRequest Bot::requestMove(const std::string &FEN, const SearchLimits &searchLimits, std::function<void(const SearchInfo&)> onProgress, std::function<void(const SearchInfo&)> onDone)
+{
+    //A Bot only searches one position at a time.
+    stop();
+
+    auto state = std::make_shared<MoveRequest::State>(parentToken);
+    state->token.setDeadline(searchLimits.moveTime);
+    state->token.setNodeLimit(searchLimits.nodes);
+    state->info.depth = searchLimits.depth;
+    state->onProgress = std::move(onProgress);
+    state->onDone = std::move(onDone);
+
+    {
+        std::lock_guard<std::mutex> lock(requestMtx);
+        request = state;
+    }
+    limits = searchLimits;
+
+    threadPool.submit(state->job, [this, state, FEN]()
+    {
+        //Search on a private Board, so the position may change while the Bot is thinking. It is kept for the next request.
+        if(!engine)
+            engine = enginePool.acquire();
+        engine->loadFEN(FEN.c_str());
+        engine->turnCounter = 0;
+        engine->turnCounterStart = 0;
+        engine->saveBoardState(0);
+        engine->checkLateGame();
+        engine->updateLegalMovement();
+        colour = engine->turnColour;
+
+        computeMove();
+    });
+
+    return MoveRequest{state};
+}
+
+void Bot::stop()
+{
+    if(request)
+        MoveRequest{request}.cancel();
+}
+
+void Bot::wait() const
+{
+    std::shared_ptr<MoveRequest::State> state;
+    {
+        std::lock_guard<std::mutex> lock(requestMtx);
+        state = request;
+    }
+    if(state)
+        MoveRequest{state}.wait();
+}
+
 void Bot::reset()
 {
     spriteMoved = false;
     spriteArrived = false;
-    searching.store(false);
-    moveChosen.store(false);
 }
 
 int Bot::chooseRandomPiece() const
 {
-    return Random::randInt(0, mainEngine.nAvailable[botColour]-1);
+    return Random::randInt(0, engine->nAvailable[colour]-1);
 }
 
-void Bot::generateMove()
+void Bot::computeMove()
 {
+    //In replay mode the random choices only depend on the masterSeed and the position, not on the thread computing the move.
+    if(Random::replay)
+        Random::seedThread(engine->getPosition().hash);
 
-    if(!searching.load())
+    switch(botType)
     {
-        searching.store(true);
+    case RANDOMBOT:
+        generateMoveRandomBot();
+        break;
 
-        //Lambda to create a thread
-        auto createThread
-        {
-            [this]()
-            {
-                std::size_t threadID = threadList.size()-1;
-                threadDone[threadID] = false;
+    case METROPOLISBOT:
+        generateMoveMetropolisBot();
+        break;
 
-                switch(botType)
-                {
-                case RANDOMBOT:
-                    generateMoveRandomBot();
-                    break;
+    case WEIGHTEDRANDOMBOT1:
+        generateMoveWeightedRandomBot1();
+        break;
 
-                case METROPOLISBOT:
-                    generateMoveMetropolisBot();
-                    break;
+    case WEIGHTEDRANDOMBOT2:
+        generateMoveWeightedRandomBot2();
+        break;
 
-                case WEIGHTEDRANDOMBOT1:
-                    generateMoveWeightedRandomBot1();
-                    break;
+    case OPTIMUMBOT1:
+        generateMoveOptimumBot1();
+        break;
 
-                case WEIGHTEDRANDOMBOT2:
-                    generateMoveWeightedRandomBot2();
-                    break;
+    case OPTIMUMBOT2:
+        generateMoveOptimumBot2();
+        break;
 
-                case OPTIMUMBOT1:
-                    generateMoveOptimumBot1();
-                    break;
+    default:
+        generateMoveRandomBot();
+        break;
+    }
 
-                case OPTIMUMBOT2:
-                    generateMoveOptimumBot2();
-                    break;
+    if(!bitboardCheck(engine->board[bestMove.start.i][bestMove.start.j]->movement, bestMove.end))
+    {
+        std::cerr << "ERROR requestMove: Generated illegal Move! ";
+        engine->printMove(bestMove);
+        std::cout << '\n';
+    }
 
-                default:
-                    generateMoveRandomBot();
-                    break;
-                }
+    //Publish the chosen Move. Not every bottype plays the move with the best weight.
+    std::function<void(const SearchInfo&)> onDone{};
+    SearchInfo info{};
+    {
+        std::lock_guard<std::mutex> lock(request->mtx);
+        request->info.bestMove = bestMove;
+        request->info.nodes = request->token.getNodes();
+        request->moveFound = true;
+        info = request->info;
+        onDone = request->onDone;
+    }
 
-                if(bitboardCheck(mainEngine.board[nextMove.start.i][nextMove.start.j]->movement, nextMove.end))
-                    moveChosen.store(true);
-                else
-                {
-                    std::cerr << "ERROR generateMove: Generated illegal Move! ";
-                    mainEngine.printMove(nextMove);
-                    std::cout << '\n';
-                }
+    if(onDone)
+        onDone(info);
+}
 
-                searching.store(false);
-                threadDone[threadID] = true;
-            }
-        };
+void Bot::reportProgress(int score, const ChessMove &move)
+{
+    std::function<void(const SearchInfo&)> onProgress{};
+    SearchInfo info{};
+    {
+        const std::unique_lock<std::mutex> lock = Trace::lock(request->mtx, "reportProgress");
+        if(request->moveFound && score <= request->info.score)
+            return;
 
-        threadDone.emplace_back(false);
-        threadList.emplace_back(createThread);
+        request->info.score = score;
+        request->info.bestMove = move;
+        request->info.nodes = request->token.getNodes();
+        request->moveFound = true;
+        info = request->info;
+        onProgress = request->onProgress;
     }
+
+    if(onProgress)
+        onProgress(info);
+}
+
+//MoveRequest-Functions
+
+bool MoveRequest::ready() const
+{
+    return state != nullptr && state->job.done();
+}
+
+void MoveRequest::wait() const
+{
+    if(state)
+        threadPool.wait(state->job);
+}
+
+ChessMove MoveRequest::get() const
+{
+    wait();
+    return getProgress().bestMove;
+}
+
+SearchInfo MoveRequest::getProgress() const
+{
+    if(!state)
+        return {};
+
+    std::lock_guard<std::mutex> lock(state->mtx);
+    return state->info;
+}
+
+void MoveRequest::cancel() const
+{
+    if(!state)
+        return;
+
+    state->token.cancel();
+    threadPool.wait(state->job);
 }
 
 void Bot::generateMoveRandomBot()
 {
-    const int r = Random::randInt( 0, mainEngine.nMovesLegal[botColour]-1 );
-    nextMove = mainEngine.moveListLegal[botColour][r];
+    const int r = Random::randInt( 0, engine->nMovesLegal[colour]-1 );
+    bestMove = engine->moveListLegal[colour][r];
 }
 
 void Bot::generateMoveMetropolisBot()
 {
-    const int sign = (botColour == PWHITE) ? +1 : -1;
-    const int weightOld = sign * mainEngine.getBoardWeight();
+    const int sign = (colour == PWHITE) ? +1 : -1;
+    const int weightOld = sign * engine->getBoardWeight();
 
     int test = 0;
-    const int nMoves = mainEngine.nMovesLegal[botColour];
+    const int nMoves = engine->nMovesLegal[colour];
+
+    //Every proposed move is searched on the same SearchContext.
+    auto context = std::make_unique<SearchContext>(request->token);
 
     while(1)
     {
@@ -2062,16 +3442,16 @@ void Bot::generateMoveMetropolisBot()
         generateMoveRandomBot();
 
         //Stop if needed.
-        if(stopThread.load())
+        if(request->token.isCancelled())
             break;
 
         //Get the weight and switch the sign such that its from the bots perspective
         int weightNew;
         //For even depths, weights tend to be small, resulting in long runtimes.
-        if(depth%2 == 0)
-            weightNew = mainEngine.getMoveWeight(depth+1, nextMove);
+        if(limits.depth%2 == 0)
+            weightNew = engine->getMoveWeight(limits.depth+1, bestMove, *context);
         else
-            weightNew = mainEngine.getMoveWeight(depth, nextMove);
+            weightNew = engine->getMoveWeight(limits.depth, bestMove, *context);
 
         //Ensure Weights are positive and nonzero.
         const int minValue = abs(std::min(weightOld, weightNew));
@@ -2098,64 +3478,32 @@ void Bot::generateMoveMetropolisBot()
 
 void Bot::generateMoveWeightedRandomBot1()
 {
-    const ChessPiece *piece = mainEngine.piecesListAvailable[botColour][chooseRandomPiece()];
+    const ChessPiece *piece = engine->piecesListAvailable[colour][chooseRandomPiece()];
     const int nMoves = piece->nMoves;
-    int movesLeft = nMoves;
     std::vector<int> weightList(nMoves);
     int minWeight = INT_MAX;
     int maxWeight = -INT_MAX;
     int maxWeightID = 0;
 
     //Get the weights of all the moves.
-    int m = 0; //Move-Index.
-    while(movesLeft > 0)
-    {
-        if(stopThread.load())
-        {
-            generateMoveRandomBot();
-            return;
-        }
+    getMoveWeights(piece->moveList, nMoves, weightList);
 
-        //How many Threads should be created.
-        const int nWeightThreads = ((movesLeft >= nThreadsBot) ? nThreadsBot : movesLeft);
-        std::vector<std::thread> weightedThreadList{};
-
-        //Setup threads.
-        for(int n=0; n<nWeightThreads; n++)
-        {
-            //Lambda to create a thread
-            auto createThread
-            {
-                [this,piece,m,n]()
-                {
-                    setMoveWeightThread(piece->moveList[m],n);
-                }
-            };
+    if(request->token.isCancelled())
+    {
+        generateMoveRandomBot();
+        return;
+    }
 
-            weightedThreadList.emplace_back(createThread);
-            m++;
-        }
-        movesLeft = nMoves - m;
+    //Determine min and max weight for later.
+    for(int m=0; m<nMoves; m++)
+    {
+        if(weightList[m] < minWeight)
+            minWeight = weightList[m];
 
-        //Wait for the threads to finish
-        for(int n=0; n<nWeightThreads; n++)
+        if(weightList[m] > maxWeight)
         {
-            weightedThreadList[n].join();
-            mtx.lock();
-            int moveWeight = nextMoveWeightList[n];
-            std::size_t index = static_cast<std::size_t>(m-nWeightThreads+n);
-            weightList[index] = moveWeight;
-            mtx.unlock();
-
-            //Determine min and max weight for later.
-            if(moveWeight < minWeight)
-                minWeight = moveWeight;
-
-            if(moveWeight > maxWeight)
-            {
-                maxWeight = moveWeight;
-                maxWeightID = m-nWeightThreads+n;
-            }
+            maxWeight = weightList[m];
+            maxWeightID = m;
         }
     }
 
@@ -2172,11 +3520,11 @@ void Bot::generateMoveWeightedRandomBot1()
     while(1)
     {
         const int ID = Random::randInt(0, nMoves-1);
-        nextMove = piece->moveList[ID];
+        bestMove = piece->moveList[ID];
         const double prob = (double)weightList[ID] / (double)Z;
         const double u = Random::randDouble();
 
-        if(stopThread.load())
+        if(request->token.isCancelled())
             break;
 
         if(u <= prob)
@@ -2185,7 +3533,7 @@ void Bot::generateMoveWeightedRandomBot1()
         test++;
         if(test >= nMoves)
         {
-            nextMove = piece->moveList[maxWeightID];
+            bestMove = piece->moveList[maxWeightID];
             break;
         }
     }
@@ -2193,63 +3541,31 @@ void Bot::generateMoveWeightedRandomBot1()
 
 void Bot::generateMoveWeightedRandomBot2()
 {
-    const int nMoves = mainEngine.nMovesLegal[botColour];
-    int movesLeft = nMoves;
+    const int nMoves = engine->nMovesLegal[colour];
     std::vector<int> weightList(nMoves);
     int minWeight = INT_MAX;
     int maxWeight = -INT_MAX;
     int maxWeightID = 0;
 
     //Get the weights of all the moves.
-    int m = 0; //Move-Index.
-    while(movesLeft > 0)
-    {
-        if(stopThread.load())
-        {
-            generateMoveRandomBot();
-            return;
-        }
+    getMoveWeights(engine->moveListLegal[colour], nMoves, weightList);
 
-        //How many Threads should be created.
-        const int nWeightThreads = ( ( movesLeft >= nThreadsBot ) ? nThreadsBot : movesLeft );
-        std::vector<std::thread> weightedThreadList{};
-
-        //Setup threads.
-        for(int n=0; n<nWeightThreads; n++)
-        {
-            //Lambda to create a thread
-            auto createThread
-            {
-                [this,m,n]()
-                {
-                    setMoveWeightThread(mainEngine.moveListLegal[botColour][m],n);
-                }
-            };
+    if(request->token.isCancelled())
+    {
+        generateMoveRandomBot();
+        return;
+    }
 
-            weightedThreadList.emplace_back(createThread);
-            m++;
-        }
-        movesLeft = nMoves - m;
+    //Determine min and max weight for later.
+    for(int m=0; m<nMoves; m++)
+    {
+        if(weightList[m] < minWeight)
+            minWeight = weightList[m];
 
-        //Wait for the threads to finish
-        for(int n=0; n<nWeightThreads; n++)
+        if(weightList[m] > maxWeight)
         {
-            weightedThreadList[n].join();
-            mtx.lock();
-            int moveWeight = nextMoveWeightList[n];
-            std::size_t index = static_cast<std::size_t>(m-nWeightThreads+n);
-            weightList[index] = moveWeight;
-            mtx.unlock();
-
-            //Determine min and max weight for later.
-            if(moveWeight < minWeight)
-                minWeight = moveWeight;
-
-            if(moveWeight > maxWeight)
-            {
-                maxWeight = moveWeight;
-                maxWeightID = m-nWeightThreads+n;
-            }
+            maxWeight = weightList[m];
+            maxWeightID = m;
         }
     }
 
@@ -2266,11 +3582,11 @@ void Bot::generateMoveWeightedRandomBot2()
     while(1)
     {
         const int ID = Random::randInt(0,nMoves-1);
-        nextMove = mainEngine.moveListLegal[botColour][ID];
+        bestMove = engine->moveListLegal[colour][ID];
         const double prob = (double)weightList[ID] / (double)Z;
         const double u = Random::randDouble();
 
-        if(stopThread.load())
+        if(request->token.isCancelled())
             return;
 
         if(u <= prob)
@@ -2279,66 +3595,83 @@ void Bot::generateMoveWeightedRandomBot2()
         test++;
         if(test >= nMoves)
         {
-            nextMove = mainEngine.moveListLegal[botColour][maxWeightID];
+            bestMove = engine->moveListLegal[colour][maxWeightID];
             break;
         }
     }
 }
 
-void Bot::setMoveWeightThread(const ChessMove &move, std::size_t threadID)
+void Bot::getMoveWeights(const ChessMove *moves, int nMoves, std::vector<int> &weightList)
 {
-    int moveWeight = mainEngine.getMoveWeight(depth,move);
-    mtx.lock();
-    nextMoveWeightList[threadID] = moveWeight;
-    mtx.unlock();
+    //Every Task gets its own SearchContext and reuses it for every nTasks-th move.
+    const int nTasks = std::max(1, std::min(nThreadsBot, nMoves));
+    std::vector<std::unique_ptr<SearchContext>> contexts(nTasks);
+    for(auto &context : contexts)
+        context = std::make_unique<SearchContext>(request->token);
+
+    TaskGroup group{};
+    for(int n=0; n<nTasks; n++)
+    {
+        SearchContext *context = contexts[n].get();
+        threadPool.submit(group, [this,moves,nMoves,nTasks,n,context,&weightList]()
+        {
+            for(int m=n; m<nMoves && !request->token.isCancelled(); m+=nTasks)
+                weightList[m] = engine->getMoveWeight(limits.depth, moves[m], *context);
+        });
+    }
+    threadPool.wait(group);
 }
 
 void Bot::generateMoveOptimumBot1()
 {
     //Pick a random Piece and get its moves.
     const int ID = chooseRandomPiece();
-    const ChessPiece *piece = mainEngine.piecesListAvailable[botColour][ID];
-    const int nMoves = piece->nMoves;
-    std::vector<ChessMove> moveList(nMoves);
-    for(int m=0; m<nMoves; m++)
-    {
-        moveList[m] = piece->moveList[m];
-    }
-
-    findOptimumMove(moveList);
+    const ChessPiece *piece = engine->piecesListAvailable[colour][ID];
+    findOptimumMove({piece->moveList, piece->moveList + piece->nMoves});
 }
 
 void Bot::generateMoveOptimumBot2()
 {
-    //Create the Movelist
-    const int nMoves = mainEngine.nMovesLegal[botColour];
-    std::vector<ChessMove> moveList(nMoves);
-    for(int m=0; m<nMoves; m++)
+    //Only search the requested moves, if there are any.
+    if(!limits.searchMoves.empty())
     {
-        moveList[m] = mainEngine.moveListLegal[botColour][m];
+        findOptimumMove({limits.searchMoves.data(), limits.searchMoves.data() + limits.searchMoves.size()});
+        return;
     }
 
-    findOptimumMove(moveList);
+    findOptimumMove({engine->moveListLegal[colour], engine->moveListLegal[colour] + engine->nMovesLegal[colour]});
 }
 
-void Bot::findOptimumMove(const std::vector<ChessMove> &moveList)
+void Bot::findOptimumMove(const MoveList &moveList)
 {
+    //Every Task gets its own SearchContext.
+    const int nMoves = moveList.size();
+    const int nTasks = (nThreadsBot <= 1 || nMoves < nThreadsBot) ? 1 : nThreadsBot;
+
+    //The search has no iterative deepening, so a single iteration searches all moves with the full depth.
+    Trace::Scope scope{"iteration", "search"};
+    scope.addArg("depth", limits.depth);
+    scope.addArg("tasks", nTasks);
+    std::vector<std::unique_ptr<SearchContext>> contexts(nTasks);
+    for(auto &context : contexts)
+        context = std::make_unique<SearchContext>(request->token);
+
     //If only one Thread is requested or needed.
-    const int nMoves = (int)moveList.size();
-    if( nThreadsBot == 1 || nMoves < nThreadsBot )
+    if(nTasks == 1)
     {
-        findNegamaxMove(moveList, 0);
-        nextMove = nextMoveList[0];
+        findNegamaxMove(moveList, *contexts[0]);
+        bestMove = contexts[0]->bestMove;
+        mergeStats(contexts);
         return;
     }
 
-    //Distribute the Moves among the Threads.
-    std::vector<std::thread> optimumThreadList{};
-    const int movesPerThread = nMoves/nThreadsBot;
-    int movesLeft = nMoves - (movesPerThread * nThreadsBot);
+    //Distribute the Moves among the Tasks.
+    TaskGroup group{};
+    const int movesPerThread = nMoves/nTasks;
+    int movesLeft = nMoves - (movesPerThread * nTasks);
     int offset = 0;
 
-    for(std::size_t n=0; n<nThreadsBot; n++)
+    for(int n=0; n<nTasks; n++)
     {
         //Determine how many Moves this Threads should handle.
         int nMovesThread = movesPerThread;
@@ -2349,104 +3682,114 @@ void Bot::findOptimumMove(const std::vector<ChessMove> &moveList)
         }
 
         //Create the Move-List.
-        std::vector<ChessMove> moveListThread(nMovesThread);
-        for(std::size_t m=0; m<nMovesThread; m++)
-        {
-            moveListThread[m] = moveList[m + offset];
-        }
+        MoveList moveListThread(moveList.begin() + offset, moveList.begin() + offset + nMovesThread);
         offset += nMovesThread;
 
-        //Lambda to create a thread
-        auto createThread
+        SearchContext *context = contexts[n].get();
+        threadPool.submit(group, [this,moveListThread,context]()
         {
-            [this,moveListThread,n]()
-            {
-                findNegamaxMove(moveListThread,n);
-            }
-        };
-
-        //Create the Thread
-        optimumThreadList.emplace_back(createThread);
+            findNegamaxMove(moveListThread, *context);
+        });
     }
 
-    //Wait for all threads to finish and find the move with the best weight.
-    int maxWeight = INT_MIN, indexMaxWeight = 0;
-    for(int n=0; n<nThreadsBot; n++)
+    //Wait for all tasks to finish and merge their results.
+    threadPool.wait(group);
+    int maxWeight = INT_MIN;
+    for(const auto &context : contexts)
     {
-        if(optimumThreadList[n].joinable())
-            optimumThreadList[n].join();
-        mtx.lock();
-        const int weight = nextMoveWeightList[n];
-        mtx.unlock();
-        if(weight > maxWeight)
+        if(context->bestWeight > maxWeight)
         {
-            maxWeight = weight;
-            indexMaxWeight = n;
+            maxWeight = context->bestWeight;
+            bestMove = context->bestMove;
         }
     }
+    mergeStats(contexts);
+}
 
-    //Get the best Move from across the threads.
-    mtx.lock();
-    nextMove = nextMoveList[indexMaxWeight];
-    mtx.unlock();
+void Bot::mergeStats(const std::vector<std::unique_ptr<SearchContext>> &contexts)
+{
+    std::lock_guard<std::mutex> lock(request->mtx);
+    for(const auto &context : contexts)
+    {
+        request->info.arenaPeak = std::max(request->info.arenaPeak, context->arena.peak());
+        if(searchStatsEnabled)
+            request->info.stats.add(context->stats);
+    }
 }
 
-void Bot::findNegamaxMove(std::vector<ChessMove> moveList, std::size_t threadID)
+void Bot::findNegamaxMove(const MoveList &moveList, SearchContext &context)
 {
-    //Initalize the board to perform the search on (necessary when using threads).
-    auto testEngine = std::make_unique<Engine>();
-    testEngine->initialize();
-    testEngine->loadFEN(mainEngine.getFEN().c_str());
-    testEngine->turnCounter = 0;
-    testEngine->turnCounterStart = 0;
-    testEngine->saveBoardState(0);
+    //Initalize the board to perform the search on (necessary when using threads). The copy-make search only needs the Position.
+    //copyMakeSearch is read once, so the whole search uses the same kind of board even if the option changes meanwhile.
+    const bool copyMake = copyMakeSearch;
+    const Position root = engine->getPosition();
+    Engine *testEngine = nullptr;
+    if(!copyMake)
+    {
+        context.loadPosition(*engine);
+        testEngine = context.engine.get();
+    }
 
     int alpha = -INT_MAX;           //-INT_MAX, since otherwise -alpha would lead to underflow.
     constexpr int beta = INT_MAX;
-    int maxWeight = -INT_MAX;
-    const PColour nextTurnColour = ((testEngine->turnColour == PWHITE) ? PBLACK : PWHITE);
+    const PColour nextTurnColour = ((colour == PWHITE) ? PBLACK : PWHITE);
 
-    mtx.lock();
-    nextMoveList[threadID] = moveList[0];
-    nextMoveWeightList[threadID] = maxWeight;
-    mtx.unlock();
+    context.bestMove = moveList[0];
+    context.bestWeight = -INT_MAX;
 
-    if(depth <= 0)
+    if(limits.depth <= 0)
         return;
 
     for(const ChessMove &move : moveList)
     {
-        if(stopThread.load())
+        if(context.counter.isStopped())
             break;
 
-        int weight = 0;
-
-        testEngine->makeMove(move);
-        testEngine->advancePseudoTurn();
+        Trace::Scope scope{"root move", "search"};
+        if(scope.isActive())
+            scope.addArg("move", engine->getMoveString(move));
 
         //Determine the Weight
-        if(testEngine->turnColour != PNONE)
+        int weight = 0;
+        if(copyMake)
         {
-            std::vector<ChessMove> newMoveList{};
-            newMoveList.assign(testEngine->moveListPseudo[nextTurnColour], testEngine->moveListPseudo[nextTurnColour] + testEngine->nMovesPseudo[nextTurnColour]);
+            Position next;
+            root.makeMove(move, next);
+            weight = -negamax(limits.depth-1, 1, -beta, -alpha, next, context);
+        }
+        else
+        {
+            testEngine->makeMove(move);
+            testEngine->advancePseudoTurn();
+
+            if(testEngine->turnColour != PNONE)
+            {
+                MoveList newMoveList(testEngine->moveListPseudo[nextTurnColour], testEngine->moveListPseudo[nextTurnColour] + testEngine->nMovesPseudo[nextTurnColour]);
+                if(limits.depth > 1)
+                    context.orderMoves(newMoveList, 1);
 
-            weight = -negamax(depth-1, 1, -beta, -alpha, newMoveList, testEngine);
+                weight = -negamax(limits.depth-1, 1, -beta, -alpha, newMoveList, context);
+            }
         }
 
-        if(weight > maxWeight)
+        //An interrupted search returns an unreliable weight.
+        if(context.counter.isStopped())
+            break;
+
+        if(weight > context.bestWeight)
         {
-            mtx.lock();
-            nextMoveList[threadID] = move;
-            nextMoveWeightList[threadID] = weight;
-            mtx.unlock();
-            maxWeight = weight;
+            context.bestMove = move;
+            context.bestWeight = weight;
             if(weight > alpha)
                 alpha = weight;
+
+            reportProgress(weight, move);
         }
 
         if(weight >= beta)
             break;
 
-        testEngine->loadBoardState(0);
+        if(!copyMake)
+            testEngine->loadBoardState(0);
     }
 }
\ No newline at end of file
@@ -1,21 +1,35 @@
 #pragma once
 #include "Random_Header.h"  //For generating random numbers. Includes <random>.
 #include "Timer_Header.h"   //For Timer-Class. Includes <chrono>.
+#include "ChessNNUE.h"      //Neural network evaluation.
+#include "ThreadPool_Header.h" //Persistent worker threads for all engine jobs.
+#include "CancelToken_Header.h" //Stops single jobs, also via deadlines and node limits.
+#include "Arena_Header.h"   //Scratch memory of the search threads.
+#include "ChessProfiler.h"   //Call counts and times of the hot functions, if built with CHESS_PROFILE.
 #include <iostream>         //For Console input and output.
 #include <array>            //Static Array Class.
 #include <vector>           //Dynamic Array Class.
+#include <initializer_list> //To fill a MoveList like an array.
 #include <string>           //String Class.
 #include <sstream>          //String-Stream, to more easily add to a string.
 #include <algorithm>        //For the sorting-Function.
 #include <thread>	        //For having multiple threads to do parallel processing.
 #include <atomic>           //For having shared variables that threads can access in a safe manner.
 #include <mutex>            //For freezing Threads.
+#include <bit>              //For counting bits in bitboards.
+#include <cstdint>          //Fixed-width integers for the compact Position.
+#include <type_traits>      //To check that Position stays trivially copyable.
+#include <cassert>          //Debug checks of the MoveList bounds.
+#include <cmath>            //For the effective branching factor of the search statistics.
 
 namespace Chess
 {
     //Counts how many seconds have passed since the Program started.
     inline Timer CLOCK{};
 
+    //Parent of every job's CancelToken. Only cancelled to stop all jobs at once.
+    inline CancelToken globalToken{};
+
     //Enum ChessPiece Attributes
     enum PType
     {
@@ -49,6 +63,13 @@ namespace Chess
         OPTIMUMBOT2,        //Best Piece and Move.
     };
 
+    //Enum available Evaluation-Functions
+    enum EvalTypes
+    {
+        HANDCRAFTEDEVAL,    //Piece-Square-Tables, Pawn-Structure, Mobility and King-Safety.
+        NNUEEVAL,           //Neural network, requires a network loaded via NNUE::loadNetwork.
+    };
+
     //Position on the board. i and j take values 0-7. i goes left to right, j goes up to down (matrix representation).
     struct BoardPos { int i{}, j{}; };
 
@@ -77,13 +98,76 @@ namespace Chess
     //Returns the value of the bitboard at pos.
     bool bitboardCheck(u64 bitboard, const BoardPos &pos);
 
+    //Bitboard Masks. Bit k = i + 8*j, so the lowest bits hold the 8th rank (j=0).
+    inline u64 bitboardFile[8]{};   //All squares with the same i.
+    inline u64 bitboardRow[8]{};    //All squares with the same j.
+
+    //Get the File- and Row-masks.
+    void bitboardInitializeMasks();
+
+    //Returns the number of bits set to 1.
+    int bitboardCount(u64 bitboard);
+
+    //Shift all bits one square to the left (i-1) or right (i+1). Bits leaving the board are discarded.
+    u64 bitboardShiftLeft(u64 bitboard);
+    u64 bitboardShiftRight(u64 bitboard);
+
+    //Shift all bits one square forward or backward, as seen from a Pawn of the given colour.
+    u64 bitboardShiftForward(u64 bitboard, PColour colour);
+    u64 bitboardShiftBackward(u64 bitboard, PColour colour);
+
+    //Smear all bits forward or backward along their file, as seen from a Pawn of the given colour. Keeps the original bits.
+    u64 bitboardFillForward(u64 bitboard, PColour colour);
+    u64 bitboardFillBackward(u64 bitboard, PColour colour);
+
+    //Returns the squares attacked by the given Pawns.
+    u64 bitboardPawnAttacks(u64 pawns, PColour colour);
+
+    //Attack-Tables for the non-sliding Pieces and Rays for the sliding Pieces, indexed by the square k.
+    inline u64 bitboardKnightAttacks[64]{};
+    inline u64 bitboardKingAttacks[64]{};
+    inline u64 bitboardRays[8][64]{};   //Directions: 0-3 towards higher bits (right, down, down-right, down-left), 4-7 towards lower bits (left, up, up-left, up-right).
+
+    //Get the Attack-Tables and Rays.
+    void bitboardInitializeAttacks();
+
+    //Returns the squares a Rook or Bishop at square k attacks, given all occupied squares. Includes the first blocker.
+    u64 bitboardRookAttacks(int k, u64 occupied);
+    u64 bitboardBishopAttacks(int k, u64 occupied);
+
+    //Returns true if the square k is attacked by any Piece of the given colour. bitboards are indexed via [PColour][PType].
+    bool bitboardSquareAttacked(int k, PColour colour, const u64 bitboards[2][6], u64 occupied);
+
+    //Zobrist-Keys to hash a Position. A Piece adds zobristPieces[PColour][PType][k], Black to move adds zobristTurn.
+    inline u64 zobristPieces[2][6][64]{}, zobristCastling[16]{}, zobristEnPassant[8]{}, zobristTurn = 0;
+
+    //Get the Zobrist-Keys. Always generates the same keys, so hashes can be compared between runs.
+    void zobristInitializeKeys();
+
+    //Castling-Rights of a Position, stored as Flags.
+    enum CastlingRights
+    {
+        CASTLEWHITEKING  = 1,
+        CASTLEWHITEQUEEN = 2,
+        CASTLEBLACKKING  = 4,
+        CASTLEBLACKQUEEN = 8,
+    };
+
     //Forward-declare all Classes
     class ChessPiece;
     class Engine;
     class Bot;
+    class MoveRequest;
+    class EnginePool;
+    class PerftTable;
+    class MoveList;
+    struct Position;
+    struct SearchContext;
+
+    //The evaluation constants are inline, so they have the same address in every file. The Tuning identifies the terms of the evaluation by it.
 
     //Piece Square Tables, numerical Data from https://www.chessprogramming.org/Simplified_Evaluation_Function (14.03.2025)
-    constexpr int PawnPST[2][8][8] =
+    inline constexpr int PawnPST[2][8][8] =
     {
         {
             {0,0,0,0,0,0,0,0},
@@ -107,7 +191,7 @@ namespace Chess
         }
     };
 
-    constexpr int KnightPST[2][8][8] =
+    inline constexpr int KnightPST[2][8][8] =
     {
         {
             {-50,-40,-30,-30,-30,-30,-40,-50},
@@ -131,7 +215,7 @@ namespace Chess
         }
     };
 
-    constexpr int BishopPST[2][8][8] =
+    inline constexpr int BishopPST[2][8][8] =
     {
         {
             {-20,-10,-10,-10,-10,-10,-10,-20},
@@ -155,7 +239,7 @@ namespace Chess
         }
     };
 
-    constexpr int RookPST[2][8][8] =
+    inline constexpr int RookPST[2][8][8] =
     {
         {
             {0,0,0,0,0,0,0,0},
@@ -179,7 +263,7 @@ namespace Chess
         }
     };
 
-    constexpr int QueenPST[2][8][8] =
+    inline constexpr int QueenPST[2][8][8] =
     {
         {
             {-20,-10,-10,-5,-5,-10,-10,-20},
@@ -203,7 +287,7 @@ namespace Chess
         }
     };
 
-    constexpr int KingPST[2][8][8] =
+    inline constexpr int KingPST[2][8][8] =
     {
         {
             {-20,-10,-10,-5,-5,-10,-10,-20},
@@ -228,35 +312,35 @@ namespace Chess
     };
 
     //Piece-Values KING,QUEEN,BISHOP,KNIGHT,ROOK,PAWN
-    constexpr int pieceValue[2][6] = {{20000,900,330,320,500,100},{20000,900,330,320,500,100}};
+    inline constexpr int pieceValue[2][6] = {{20000,900,330,320,500,100},{20000,900,330,320,500,100}};
 
-    //Mobility Score.
+    //Mobility Score. Indexed by the number of attacked squares within the mobility area.
 
-    constexpr int RookMobility[2][15] = 
+    inline constexpr int RookMobility[2][15] = 
     {
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130,140}, 
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130,140}
     };
     
-    constexpr int KnightMobility[2][9] = 
+    inline constexpr int KnightMobility[2][9] = 
     {
         {0,10,20,30,40,50,60,70,80},
         {0,10,20,30,40,50,60,70,80}
     };
 
-    constexpr int BishopMobility[2][14] = 
+    inline constexpr int BishopMobility[2][14] = 
     {
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130},
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130}
     };
 
-    constexpr int QueenMobility[2][28] = 
+    inline constexpr int QueenMobility[2][28] = 
     {
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130,140,150,160,170,180,190,200,210,220,230,240,250,260,270},
         {0,10,20,30,40,50,60,70,80,90,100,110,120,130,140,150,160,170,180,190,200,210,220,230,240,250,260,270}
     };
 
-    constexpr int KingMobility[2][9] =
+    inline constexpr int KingMobility[2][9] =
     {
         {0,10,20,30,40,50,60,70,80},
         {0,10,20,30,40,50,60,70,80}
@@ -264,14 +348,125 @@ namespace Chess
 
     //Pawn Score.
 
-    constexpr int PawnDoubled[2] = {-50,-50};   //Doubled Pawn:  Two friendly Pawns on the same file.
-    constexpr int PawnIsolated[2] = {-50,-50};  //Isolated Pawn: No friendly Pawns on the neighbouring files.
-    constexpr int PawnBlocked[2] = {-50,-50};   //Blocked Pawn:  Pawn cannot move.
+    inline constexpr int PawnDoubled[2] = {-50,-50};   //Doubled Pawn:  Two friendly Pawns on the same file.
+    inline constexpr int PawnIsolated[2] = {-50,-50};  //Isolated Pawn: No friendly Pawns on the neighbouring files.
+    inline constexpr int PawnBlocked[2] = {-50,-50};   //Blocked Pawn:  Pawn cannot move.
+    inline constexpr int PawnBackward[2] = {-20,-20};  //Backward Pawn: Stop-square is attacked by an enemy Pawn and cannot be covered by friendly Pawns.
+
+    //Passed Pawn: No enemy Pawns in front of it on its own or neighbouring files. Indexed by the rank as seen from the Pawn.
+    inline constexpr int PawnPassed[2][8] =
+    {
+        {0,5,10,20,35,60,100,0},
+        {0,10,20,40,70,120,200,0}
+    };
 
     //King Safety
-    constexpr int KingCheck[2] = {-2000,-2000};
+    inline constexpr int KingCheck[2] = {-2000,-2000};
 }
 
+//List of ChessMoves with a fixed capacity, stored inline instead of on the heap. Used by the search, so no node allocates memory.
+class Chess::MoveList
+{
+public:
+    static constexpr int capacity = nMovesMaxTotal;
+
+    MoveList() {}
+    MoveList(const ChessMove *first, const ChessMove *last) { assign(first, last); }
+    MoveList(std::initializer_list<ChessMove> list) { assign(list.begin(), list.end()); }
+
+    MoveList(const MoveList &other) { assign(other.begin(), other.end()); }
+    MoveList &operator=(const MoveList &other) { assign(other.begin(), other.end()); return *this; }
+
+    //Replace the content with the moves from first to last.
+    void assign(const ChessMove *first, const ChessMove *last)
+    {
+        assert(first <= last && last - first <= capacity);
+        nMoves = (int)(last - first);
+        std::copy(first, last, storage.moves);
+    }
+
+    void push_back(const ChessMove &move) { assert(nMoves < capacity); storage.moves[nMoves++] = move; }
+    void resize(int n) { assert(n >= 0 && n <= capacity); nMoves = n; }
+    void clear() { nMoves = 0; }
+
+    int size() const { return nMoves; }
+    bool empty() const { return nMoves == 0; }
+
+    ChessMove *data() { return storage.moves; }
+    const ChessMove *data() const { return storage.moves; }
+    ChessMove *begin() { return storage.moves; }
+    const ChessMove *begin() const { return storage.moves; }
+    ChessMove *end() { return storage.moves + nMoves; }
+    const ChessMove *end() const { return storage.moves + nMoves; }
+
+    ChessMove &operator[](int m) { return storage.moves[m]; }
+    const ChessMove &operator[](int m) const { return storage.moves[m]; }
+
+private:
+    //The union keeps the moves uninitialized, only the first nMoves are valid. Otherwise every node would clear the whole array.
+    union Storage
+    {
+        Storage() {}
+        ChessMove moves[capacity];
+    } storage;
+
+    int nMoves = 0;
+};
+
+//Compact Boardstate that consists only of Bitboards and Flags. Trivially copyable, so it can be copied with memcpy and handed to other threads.
+//Searches can work on it copy-make style: makeMove writes the next Position into a copy, the old Position stays untouched.
+struct Chess::Position
+{
+    u64 bitboards[2][6]{};                  //Indexed via [PColour][PType].
+    u64 hash = 0;                           //Zobrist-Key, kept up to date by makeMove.
+    PColour turnColour = PWHITE;            //PNONE if the game is over.
+    std::uint32_t turnCounter = 0;          //Number of halfturns, like Engine::turnCounter.
+    std::uint16_t turnsUntilDrawCounter = 0;
+    std::uint8_t castling = 0;              //CastlingRights-Flags.
+    std::int8_t enpassant = -1;             //Square k = i + 8*j a Pawn can move to by capturing en-passant, -1 if there is none.
+
+    //Bitboard of all Pieces of colour.
+    u64 occupied(PColour colour) const;
+
+    //Bitboard of all Pieces.
+    u64 occupied() const;
+
+    //Find the Piece on square k. Returns false if the square is empty.
+    bool getPiece(int k, PColour &colour, PType &type) const;
+
+    //Calculate the Zobrist-Key from scratch.
+    u64 computeHash() const;
+
+    //True if the King of colour is attacked.
+    bool inCheck(PColour colour) const;
+
+    //Same conditions as Engine::checkLateGame, but counted by the type of the Pieces.
+    bool isLateGame() const;
+
+    //True if turnColour may castle to the King- or Queen-side: Rights, empty squares and the King neither starts in nor passes through check.
+    bool canCastle(bool kingSide) const;
+
+    //Replace moveList with all pseudolegal moves of turnColour. Castling is only generated if canCastle.
+    void generateMoves(MoveList &moveList) const;
+
+    //Write the Position after move into next. Returns false if the move leaves the own King in check.
+    bool makeMove(const ChessMove &move, Position &next) const;
+
+    //Same result as makeMove for a pseudolegal move, but only moves the Pieces needed to test the own King.
+    bool isLegal(const ChessMove &move) const;
+
+    //Number of legal moves of turnColour. Used for bulk-counting the last ply of a perft-Test.
+    int countLegalMoves() const;
+
+    //Get the Weight of the Position with the selected evaluation, same as Engine::getBoardWeight.
+    int getWeight() const;
+
+    //Get the NNUE-Weight of the Position from an Accumulator that is already up to date, instead of rebuilding it.
+    int getWeight(const NNUE::Accumulator &accumulator) const;
+};
+
+static_assert(std::is_trivially_copyable_v<Chess::Position>, "Position must stay trivially copyable.");
+
 //Class representing a single Chesspiece.
 class Chess::ChessPiece
 {
@@ -390,6 +585,9 @@ public:
     //Print a given Chessmove.
     void printMove(const ChessMove &move) const;
 
+    //A given Chessmove in the notation of printMove, e.g. e2e4 or e7e8Q.
+    std::string getMoveString(const ChessMove &move) const;
+
     //Prints the letter accociated with the ChessType
     char getPTypeLetter(PType type) const;
 
@@ -441,6 +639,10 @@ private:
 
     //Reset all en-passant Flags. Must be done before one executes a move.
     void resetEnPassantFlags();
+
+    //Places the first dead ChessPiece of type and colour at pos. Uses a transformed Pawn if there is none left.
+    //If startOnly is set, only a ChessPiece that starts on pos is placed. Returns false if there was none.
+    bool placePiece(const BoardPos &pos, PType type, PColour colour, bool startOnly = false);
 public:
     //Execute a pseudolegal Chessmove. Returns true if the Move was legal.
     bool makeMove(const ChessMove &move);
@@ -459,6 +661,15 @@ public:
     //Takes a FEN-String, loads the Boardstate and saves it at the current turnCounter.
     void loadFEN(const char *FEN);
 
+    //Copies the current Boardstate of source, including all generated moves. Much faster than a getFEN/loadFEN round trip. Does not copy the saved BoardStates.
+    void copyPosition(const Engine &source);
+
+    //Export the current Boardstate as a compact Position.
+    Position getPosition() const;
+
+    //Load a Position like loadFEN: Places the ChessPieces, sets the flags and updates the pseudolegal movement.
+    void loadPosition(const Position &position);
+
     //Turns the current Boardstate into a FEN.
     std::string getFEN() const;
     
@@ -468,11 +679,20 @@ public:
     //Get the correct Piece-Square-Table value for a given position and chesspiece.
     int getPositionWeight(const BoardPos &pos, PType type, PColour colour) const;
 
+    //Fill the Bitboards of every ChessPiece-type, indexed via [PColour][PType].
+    void getPieceBitboards(u64 bitboards[2][6]) const;
+
     //Get the Weight of the current Board.
     int getBoardWeight() const;
 
-    //Get the estimated weight for a move with a given depth.
-    int getMoveWeight(int depth, const ChessMove &move) const;
+    //Recalculate the NNUE-Accumulator from scratch.
+    void refreshAccumulator();
+
+    //Update the NNUE-Accumulator for a move that is about to be executed.
+    void updateAccumulator(const ChessMove &move);
+
+    //Get the estimated weight for a move with a given depth, searched on context. Stops early once the token of context is cancelled.
+    int getMoveWeight(int depth, const ChessMove &move, SearchContext &context) const;
 
     //Advance the Turn for Weight calculations without calculating legal moves.
     void advancePseudoTurn();
@@ -499,6 +719,9 @@ public:
     //The squares that are within the attack-range. Different from dangerZone because of Pawns.
     u64 attackZone[2]{};
 
+    //The first layer of the NNUE for the current board. Only kept up to date while useNNUE() is true.
+    NNUE::Accumulator accumulator{};
+
     //Declaration of all Chesspieces
     ChessPiece  
         kingWhite{{4,7},KING,PWHITE,*this},      kingBlack{{4,0},KING,PBLACK,*this},
@@ -577,6 +800,7 @@ public:
         //Chessboard Variables
         ChessPiece *board[8][8]{};
         u64 dangerZone[2]{};
+        NNUE::Accumulator accumulator{};
 
         //Chesspiece Variables
         PType type[2][nPieces]{};
@@ -592,37 +816,257 @@ public:
     std::size_t boardStateListSize{10};
 };
 
+namespace Chess
+{
+    //Limits of a single Bot::requestMove.
+    struct SearchLimits
+    {
+        int depth = 5;
+        double moveTime = 0.0;                  //In seconds. 0 means no limit.
+        u64 nodes = 0;                          //0 means no limit.
+        std::vector<ChessMove> searchMoves{};   //Only search these moves. Only used by OPTIMUMBOT2, empty means all legal moves.
+    };
+
+    //Statistics of a negamax search, to tune the move ordering against. Only counted if built with CHESS_SEARCH_STATS, see SEARCH_STATS.
+    struct SearchStats
+    {
+        static constexpr int maxPly = 64;
+        u64 nodes[maxPly+1]{};          //Nodes per ply. The positions after the root moves are ply 1, deeper plies are counted in nodes[maxPly].
+        u64 leafNodes = 0;              //Nodes that were evaluated instead of searched further.
+        u64 cutoffs = 0;                //Nodes that failed high.
+        u64 firstMoveCutoffs = 0;       //Cutoffs caused by the first legal move, a measure of the move ordering.
+
+        //Add the statistics of another search thread.
+        void add(const SearchStats &other);
+
+        //Print the nodes and branching factor per ply, the fail-high rate and the share of leaf nodes as info strings.
+        void print(std::ostream &out) const;
+    };
+
+    //True if the engine was built with CHESS_SEARCH_STATS.
+#ifdef CHESS_SEARCH_STATS
+    inline constexpr bool searchStatsEnabled = true;
+#else
+    inline constexpr bool searchStatsEnabled = false;
+#endif
+
+    //Progress of a search. Reported whenever the bot finds a better move.
+    struct SearchInfo
+    {
+        int depth = 0;
+        int score = 0;          //Weight of bestMove from the perspective of the bot.
+        ChessMove bestMove{};
+        u64 nodes = 0;
+        SearchStats stats{};    //Merged from all search threads once the search is done.
+        std::size_t arenaPeak = 0;  //Most scratch memory a single search thread used at once, in bytes. Only measured in debug builds.
+    };
+}
+
+//Counts search statistics only if built with CHESS_SEARCH_STATS, otherwise the statement is removed.
+#ifdef CHESS_SEARCH_STATS
+#define SEARCH_STATS(...) __VA_ARGS__
+#else
+#define SEARCH_STATS(...)
+#endif
+
+//Keeps the Engines of finished searches, so later searches neither allocate nor initialize a new Engine.
+class Chess::EnginePool
+{
+public:
+    //Deleter that hands an Engine back to enginePool.
+    struct Recycler
+    {
+        void operator()(Engine *engine) const;
+    };
+    using Handle = std::unique_ptr<Engine, Recycler>;
+
+    //Take an unused Engine, or create one if there is none left.
+    Handle acquire();
+
+    //Delete all unused Engines.
+    void clear();
+
+    //Number of unused Engines.
+    std::size_t size();
+
+private:
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Engine>> engines{};
+};
+
+//Hash table for perft-Tests: Stores the number of nodes a Position has at a given depth, so transposed subtrees are only counted once.
+//Shared by all threads without locks. Every entry stores its key xor its node count, so an entry torn by two threads writing at once no longer matches and is simply missed.
+class Chess::PerftTable
+{
+public:
+    //Reserve up to sizeMB Megabytes, rounded down to a power of two number of entries. 0 disables the table. Must not be called during a perft-Test.
+    void resize(std::size_t sizeMB);
+
+    //Remove all entries. A perft-Test running meanwhile only misses the removed entries.
+    void clear();
+
+    //Look up the nodes of the Position with hash at depth. Returns false if they are not stored.
+    bool probe(u64 hash, int depth, u64 &nodes) const;
+
+    //Store the nodes of the Position with hash at depth. Replaces the entry that was there.
+    void store(u64 hash, int depth, u64 nodes);
+
+    //Size of the table in Megabytes.
+    std::size_t sizeMB() const;
+
+private:
+    struct Entry
+    {
+        std::atomic<u64> key{0}, nodes{0};   //key holds the hash of Position and depth xor nodes.
+    };
+
+    //Combine hash and depth into the key of an entry.
+    static u64 entryKey(u64 hash, int depth);
+
+    std::unique_ptr<Entry[]> entries{};
+    std::size_t nEntries = 0;
+};
+
+namespace Chess
+{
+    //Shared by all searches.
+    inline EnginePool enginePool{};
+
+    //Shared by all perft-Tests. Resized via the PerftHash option.
+    inline PerftTable perftTable{};
+}
+
+//Everything a single search thread works with: its board including the undo stack (boardStateList), move-ordering tables, node counter and best move.
+//Aligned to cache lines, so threads never write to the same line. The results of several contexts are only merged after the search.
+struct alignas(64) Chess::SearchContext
+{
+    static constexpr int maxPly = 64;
+    static constexpr std::size_t scratchSize = 16*1024; //Bytes of scratch memory per thread.
+
+    explicit SearchContext(CancelToken &token): counter{token} {}
+
+    EnginePool::Handle engine{};            //Taken from the enginePool by loadPosition.
+    NodeCounter counter;
+    ChessMove killers[maxPly][2]{};         //The last two quiet moves per ply that caused a beta-cutoff.
+    int history[2][64][64]{};               //Bonus for quiet moves that caused a beta-cutoff, indexed via [PColour][start][end].
+    ChessMove bestMove{};
+    int bestWeight = -INT_MAX;
+    Arena arena{scratchSize};               //Temporary arrays of the move ordering. Reset by loadPosition.
+    SearchStats stats{};                    //Only counted if built with CHESS_SEARCH_STATS.
+
+    //Take an Engine from the enginePool and copy the current position of source into it.
+    void loadPosition(const Engine &source);
+
+    //Sort moveList of the current position: Captures by the value of the captured piece, then the killer moves of ply, then quiet moves by history.
+    void orderMoves(MoveList &moveList, int ply);
+
+    //Same for the moves of a Position, used by the copy-make search.
+    void orderMoves(MoveList &moveList, int ply, const Position &position);
+
+    //Sort the nMoves moves of colour. captureValues holds the value of the piece each move captures, -1 for quiet moves.
+    void sortMoves(ChessMove *moveList, int nMoves, const int *captureValues, PColour colour, int ply);
+
+    //Remember a quiet move of colour that caused a beta-cutoff at ply.
+    void storeCutoff(const ChessMove &move, PColour colour, int ply, int depth);
+};
+
+//Handle to a move requested via Bot::requestMove, similar to a std::future.
+//A worker of the threadPool that waits for it helps with the search instead of blocking.
+class Chess::MoveRequest
+{
+public:
+    MoveRequest() = default;
+
+    //False if no move has been requested.
+    bool valid() const { return state != nullptr; }
+
+    //True once the search has finished. Does not block.
+    bool ready() const;
+
+    //Block until the search has finished.
+    void wait() const;
+
+    //Wait for the search and return the chosen move.
+    ChessMove get() const;
+
+    //The best move found so far.
+    SearchInfo getProgress() const;
+
+    //Stop the search and wait until it has finished. The best move found so far is still chosen.
+    void cancel() const;
+
+private:
+    friend class Bot;
+
+    //Shared between the handle and the running search.
+    struct State
+    {
+        explicit State(const CancelToken *parent): token{parent} {}
+
+        CancelToken token;
+        TaskGroup job{};
+        std::mutex mtx;                 //Protects info and moveFound.
+        SearchInfo info{};
+        bool moveFound = false;
+        std::function<void(const SearchInfo&)> onProgress{}, onDone{};
+    };
+
+    explicit MoveRequest(std::shared_ptr<State> state): state{std::move(state)} {}
+
+    std::shared_ptr<State> state{};
+};
+
 //Bot-Class: Chooses what moves to play for a given colour.
 class Chess::Bot
 {
 public:
-    Bot(PColour colour): botColour{colour}{ updateThreadSize(); }
+    Bot(PColour colour, const CancelToken *parentToken = &globalToken): botColour{colour}, parentToken{parentToken}{ updateThreadSize(); }
 
     const PColour botColour;
     BotTypes botType = OPTIMUMBOT2;
     int depth = 5, nThreadsBot = 1;
-    ChessMove nextMove{};
-    std::vector<ChessMove> nextMoveList{  };
-    std::vector<int> nextMoveWeightList{};
+    ChessMove nextMove{};                   //The move executeMove plays. Set by the owner of the Bot from a finished MoveRequest.
     bool spriteMoved = false, spriteArrived = false;
-    std::atomic<bool> searching{false}, moveChosen{false};
 
-    //Set the move depending on the bottype and store it in nextMove.
-    void generateMove();
+    /*Start searching a move for the side to move in FEN as a task on the threadPool. A running search of this Bot is stopped first.
+    onProgress is called whenever a better move is found, onDone once with the chosen move. Both run on the searching thread and must not wait for the request.*/
+    MoveRequest requestMove(const std::string &FEN, const SearchLimits &searchLimits, std::function<void(const SearchInfo&)> onProgress = {}, std::function<void(const SearchInfo&)> onDone = {});
 
     //Executes the move stored in nextMove and advance the turn.
     void executeMove() const;
 
+    //Cancel the running search and wait until it has finished.
+    void stop();
+
+    //Wait until the running search has finished without cancelling it. May be called from another thread than the owner of the Bot.
+    void wait() const;
+
     //Reset all Variables.
     void reset();
 
     //Adjust ThreadSize.
     void updateThreadSize();
 
+private:
+    const CancelToken *parentToken;
+    std::shared_ptr<MoveRequest::State> request{};  //The current search.
+    mutable std::mutex requestMtx;                  //Protects request, since other threads may wait for it.
+    SearchLimits limits{};
+    EnginePool::Handle engine{};                    //Copy of the requested position, taken from the enginePool.
+    PColour colour = PWHITE;                        //Side to move in engine.
+    ChessMove bestMove{};
+
+    //Set the move depending on the bottype and publish it to the request.
+    void computeMove();
+
+    //Publish a move to the request if it is better than the moves found so far.
+    void reportProgress(int score, const ChessMove &move);
+
     //Distribute the moves among Threads and find the best move.
-    void findOptimumMove(const std::vector<ChessMove> &moveList);
+    void findOptimumMove(const MoveList &moveList);
 
-private:
+    //Add the search statistics of all contexts to the request, only counted if built with CHESS_SEARCH_STATS, and record the largest arena peak.
+    void mergeStats(const std::vector<std::unique_ptr<SearchContext>> &contexts);
 
     //Return the index of a random piece from piecesListAvailable.
     int chooseRandomPiece() const;
@@ -639,8 +1083,8 @@ private:
     //Pick a weighted random piece and move.
     void generateMoveWeightedRandomBot2();
 
-    //Get the weight of a move via a thread.
-    void setMoveWeightThread(const ChessMove &move, std::size_t threadID);
+    //Store the weights of the nMoves moves in weightList. The moves are distributed among the Tasks, each searching on its own SearchContext.
+    void getMoveWeights(const ChessMove *moves, int nMoves, std::vector<int> &weightList);
 
     //Pick a random piece and its best move.
     void generateMoveOptimumBot1();
@@ -648,8 +1092,8 @@ private:
     //Pick the best piece and move.
     void generateMoveOptimumBot2();
 
-    //Find the best Move according to negamax.
-    void findNegamaxMove(std::vector<ChessMove> moveList, std::size_t threadID);
+    //Find the best Move of moveList according to negamax and store it in the bestMove-slot of context.
+    void findNegamaxMove(const MoveList &moveList, SearchContext &context);
 };
 
 namespace Chess
@@ -661,22 +1105,52 @@ namespace Chess
 
     //Weight Calculations
 
+    //Evaluation-Function used by getBoardWeight.
+    inline EvalTypes evalType = HANDCRAFTEDEVAL;
+
+    //Returns true if the NNUE is selected and a network has been loaded.
+    bool useNNUE();
+
+    //Receives every term of the handcrafted evaluation: the evaluation constant it uses and how often it is counted, positive for White.
+    //The Weight is the sum of value*count over all terms. Used to extract the features for the Tuning.
+    struct EvalSink
+    {
+        virtual void add(const int &value, int count) = 0;
+    };
+
+    //The handcrafted evaluation only depends on the Bitboards, indexed via [PColour][PType], and the lateGame-Flag.
+    //If sink is given, every term of the Weight is passed to it as well.
+
+    //Get the Weight of the Piece-Square-Tables and Piece-Values.
+    int getPieceWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink = nullptr);
+
+    //Get the Weight of the Pawn-Structure (doubled, isolated, blocked, backward and passed Pawns).
+    int getPawnWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink = nullptr);
+
+    //Get the Mobility- and King-Safety-Weight from the attacked squares of every Piece. Needs no generated moves.
+    int getMobilityWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink = nullptr);
+
+    //Sum of all handcrafted Weights. Used by getBoardWeight if the NNUE is not in use.
+    int getHandcraftedWeight(const u64 bitboards[2][6], bool lateGame, EvalSink *sink = nullptr);
+
     //Negamax search.
-    int negamax(int depth, int saveCounter, int alpha, int beta, const std::vector<ChessMove> &moveList, std::unique_ptr<Engine> &engine);
+    int negamax(int depth, int saveCounter, int alpha, int beta, const MoveList &moveList, SearchContext &context);
 
-    //Thread Functions
+    //Negamax search on a Position via copy-make. Needs no Engine, only the move-ordering tables of context.
+    //accumulator belongs to position and is only used with NNUE. If it is nullptr, it is built from position.
+    int negamax(int depth, int ply, int alpha, int beta, const Position &position, SearchContext &context, const NNUE::Accumulator *accumulator = nullptr);
 
-    //Delete Threads from threadlist that have set threadDone = true.
-    void cleanUpThreads();
+    //Let Bots and perft-Tests search on Positions via copy-make instead of make/unmake on an Engine.
+    inline std::atomic<bool> copyMakeSearch{false};
+
+    //Thread Functions
 
-    //Stops all active threads.
+    //Cancels every job via globalToken and waits until the threadPool is idle.
     void stopAllThreads();
 
     //Thread Variables
     inline int nThreads = std::thread::hardware_concurrency();  //How many Threads should be used.
-    inline std::atomic<bool> stopThread{false};		            //Shared flag to signal all threads to stop.
-    inline std::vector<std::thread> threadList{};		        //List of all threads currently running.
-    inline std::vector<bool> threadDone{};				        //List of bools to signal if a Thread has finished.
+    inline ThreadPool threadPool{};                             //Executes every engine job. Started with nThreads workers by initialize.
     inline std::mutex mtx, mtx2, mtx3;		                    //Mutex-Locks to safely access thread-Variables.
 
     //Bots
@@ -55,4 +55,5 @@ void unloadGame()
 	Resources::unload();
 	Window.unload();
 	Chess::stopAllThreads();
+	Chess::threadPool.stop();
 }
\ No newline at end of file
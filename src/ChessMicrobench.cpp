@@ -0,0 +1,210 @@
+#include "ChessMicrobench.h"
+#include "ChessBatchEval.h"
+#include <fstream>          //For writing the CSV-File.
+#include <iomanip>          //For aligning the table.
+
+using namespace Chess;
+
+namespace
+{
+    //The results of the benchmarked functions are added here, so the compiler cannot remove the calls.
+    volatile u64 sink = 0;
+
+    //A new Engine with the position FEN, saved as BoardState 0.
+    std::unique_ptr<Engine> loadEngine(const char *FEN)
+    {
+        auto engine = std::make_unique<Engine>();
+        engine->initialize();
+        engine->loadFEN(FEN);
+        engine->turnCounter = 0;
+        engine->turnCounterStart = 0;
+        engine->updateLegalMovement();
+        engine->saveBoardState(0);
+        return engine;
+    }
+
+    //Store the positions after every legal move of engine in positions and their getBoardWeight in weights.
+    void collectPositions(Engine &engine, std::vector<BatchEval::Position> &positions, std::vector<int> &weights)
+    {
+        const PColour colour = engine.turnColour;
+        const MoveList moveList(engine.moveListPseudo[colour], engine.moveListPseudo[colour] + engine.nMovesPseudo[colour]);
+        for(const ChessMove &move : moveList)
+        {
+            if(engine.makeMove(move))
+            {
+                positions.push_back(BatchEval::getPosition(engine));
+                weights.push_back(engine.getBoardWeight());
+            }
+            engine.loadTestBoardState(0);
+        }
+        engine.loadBoardState(0);
+    }
+}
+
+bool Microbench::checkBatchEval(const char *FEN)
+{
+    auto engine = loadEngine(FEN);
+    std::vector<BatchEval::Position> positions{};
+    std::vector<int> expected{};
+    collectPositions(*engine, positions, expected);
+
+    std::vector<int> weights(positions.size());
+    BatchEval::evaluate(positions.data(), positions.size(), weights.data());
+    for(std::size_t n=0; n<positions.size(); n++)
+    {
+        if(weights[n] != expected[n] || BatchEval::evaluate(positions[n]) != expected[n])
+        {
+            std::cerr << "ERROR Microbench: BatchEval gives " << weights[n] << " instead of getBoardWeight " << expected[n] << " for position " << n << "!\n";
+            return false;
+        }
+    }
+
+    std::cout << "INFO: BatchEval (" << BatchEval::simdName() << ") matches getBoardWeight on " << positions.size() << " positions.\n";
+    return true;
+}
+
+std::vector<Microbench::Result> Microbench::runAll(const char *FEN)
+{
+    std::vector<Result> results{};
+    auto engine = loadEngine(FEN);
+
+    //Move generation of a single ChessPiece, for every type the side to move has.
+    const PColour colour = engine->turnColour;
+    for(int t=KING; t<=PAWN; t++)
+    {
+        for(ChessPiece *piece : engine->piecesList[colour])
+        {
+            if(piece->alive && piece->type == t)
+            {
+                //The ChessPiece also appends its moves to the list of the Engine, which is emptied first so it cannot overflow.
+                results.push_back(measure("updatePseudolegalMovement " + PTypeString((PType)t), [&engine, piece, colour]()
+                {
+                    engine->nMovesPseudo[colour] = 0;
+                    piece->updatePseudolegalMovement();
+                    sink = sink + piece->nMovesPseudo;
+                }));
+                break;
+            }
+        }
+    }
+    engine->loadBoardState(0);
+
+    //Make every pseudolegal move in turn and restore the board, like the search does.
+    const MoveList moveList(engine->moveListPseudo[colour], engine->moveListPseudo[colour] + engine->nMovesPseudo[colour]);
+    int m = 0;
+    results.push_back(measure("makeMove + loadTestBoardState", [&]()
+    {
+        sink = sink + engine->makeMove(moveList[m]);
+        engine->loadTestBoardState(0);
+        m = (m+1 < moveList.size()) ? m+1 : 0;
+    }));
+    engine->loadBoardState(0);
+
+    results.push_back(measure("updateLegalMovement", [&]()
+    {
+        engine->updateLegalMovement();
+        sink = sink + engine->nMovesLegal[colour];
+    }));
+    engine->loadBoardState(0);
+
+    results.push_back(measure("getBoardWeight", [&]()
+    {
+        sink = sink + engine->getBoardWeight();
+    }));
+
+    //The same evaluation for all positions after the legal moves at once, per position.
+    std::vector<BatchEval::Position> positions{};
+    std::vector<int> weights{};
+    collectPositions(*engine, positions, weights);
+    if(!positions.empty())
+    {
+        Result batch = measure("BatchEval::evaluate per position", [&]()
+        {
+            BatchEval::evaluate(positions.data(), positions.size(), weights.data());
+            sink = sink + weights[0];
+        });
+        batch.median /= positions.size();
+        batch.min /= positions.size();
+        batch.mean /= positions.size();
+        batch.stddev /= positions.size();
+        results.push_back(batch);
+    }
+
+    results.push_back(measure("loadFEN", [&]()
+    {
+        engine->loadFEN(FEN);
+    }));
+
+    results.push_back(measure("getFEN", [&]()
+    {
+        sink = sink + engine->getFEN().size();
+    }));
+
+    engine->turnCounter = 0;
+    results.push_back(measure("saveBoardState", [&]()
+    {
+        engine->saveBoardState(1);
+    }));
+
+    results.push_back(measure("loadBoardState", [&]()
+    {
+        engine->loadBoardState(1);
+    }));
+
+    results.push_back(measure("loadTestBoardState", [&]()
+    {
+        engine->loadTestBoardState(1);
+    }));
+
+    return results;
+}
+
+void Microbench::print(const std::vector<Result> &results, std::ostream &out, bool csv)
+{
+    if(csv)
+    {
+        out << "name,median_ns,min_ns,mean_ns,stddev_ns,calls_per_batch\n";
+        for(const Result &result : results)
+            out << result.name << ',' << result.median << ',' << result.min << ',' << result.mean << ',' << result.stddev << ',' << result.callsPerBatch << '\n';
+        return;
+    }
+
+    out << std::left << std::setw(40) << "Function" << std::right << std::setw(12) << "median ns" << std::setw(12) << "min ns" << std::setw(12) << "stddev ns" << '\n';
+    for(const Result &result : results)
+    {
+        out << std::left << std::setw(40) << result.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << result.median << std::setw(12) << result.min << std::setw(12) << result.stddev << '\n';
+    }
+    out << std::defaultfloat;
+}
+
+int Microbench::run(int argc, char *argv[])
+{
+    Chess::initialize();
+
+    //Kiwipete: Every piece type, castling and many captures.
+    const char *FEN = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ";
+    if(!checkBatchEval(FEN))
+    {
+        threadPool.stop();
+        return 1;
+    }
+
+    const std::vector<Result> results = runAll(FEN);
+    print(results, std::cout, false);
+
+    if(argc > 0)
+    {
+        std::ofstream file(argv[0]);
+        if(!file)
+        {
+            std::cerr << "ERROR Microbench: Could not write " << argv[0] << "!\n";
+            return 1;
+        }
+        print(results, file, true);
+        std::cout << "INFO: Results written to " << argv[0] << ".\n";
+    }
+
+    threadPool.stop();
+    return 0;
+}
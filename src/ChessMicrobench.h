@@ -0,0 +1,65 @@
+#pragma once
+#include "ChessEngine.h"
+#include <cmath>            //For sqrt.
+
+//Microbenchmarks of single engine functions, to see which part of the move generation and evaluation got faster or slower.
+//Every function is warmed up and then timed in several batches, the result is the time per call in nanoseconds.
+namespace Chess::Microbench
+{
+    //Timing of a single function over all batches, in nanoseconds per call.
+    struct Result
+    {
+        std::string name{};
+        double median = 0.0, min = 0.0, mean = 0.0, stddev = 0.0;
+        u64 callsPerBatch = 0;
+    };
+
+    //Call function for warmupTime seconds, then time nBatches batches of about batchTime seconds each.
+    template<typename Function>
+    Result measure(const std::string &name, Function &&function, int nBatches = 15, double batchTime = 0.02, double warmupTime = 0.05)
+    {
+        //Warm up the caches and find how many calls fill a batch.
+        u64 nCalls = 1;
+        const Timer warmup{};
+        while(warmup.getTime() < warmupTime)
+        {
+            const Timer timer{};
+            for(u64 n=0; n<nCalls; n++)
+                function();
+            if(timer.getTime() < batchTime)
+                nCalls *= 2;
+        }
+
+        std::vector<double> times(nBatches);
+        for(double &time : times)
+        {
+            const Timer timer{};
+            for(u64 n=0; n<nCalls; n++)
+                function();
+            time = timer.getTime() * 1e9 / (double)nCalls;
+        }
+        std::sort(times.begin(), times.end());
+
+        Result result{name, times[nBatches/2], times[0], 0.0, 0.0, nCalls};
+        for(double time : times)
+            result.mean += time / nBatches;
+        for(double time : times)
+            result.stddev += (time - result.mean) * (time - result.mean) / nBatches;
+        result.stddev = std::sqrt(result.stddev);
+        return result;
+    }
+
+    //Check that BatchEval::evaluate gives the same weights as getBoardWeight on the positions after every legal move of FEN, in batches and one by one.
+    //Prints the first difference and returns false if there is one.
+    bool checkBatchEval(const char *FEN);
+
+    //Run all microbenchmarks on the position FEN.
+    std::vector<Result> runAll(const char *FEN);
+
+    //Print the results as a table, or as CSV if csv is set.
+    void print(const std::vector<Result> &results, std::ostream &out, bool csv);
+
+    //Command line mode "microbench [csv-file]": Checks BatchEval and runs all microbenchmarks without opening a window. The results are also written to the CSV-file if one is given.
+    //Returns 1 if BatchEval differs from getBoardWeight.
+    int run(int argc, char *argv[]);
+}
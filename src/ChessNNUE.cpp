@@ -0,0 +1,215 @@
+#include "ChessNNUE.h"
+#include <fstream>          //For reading the network file.
+#include <vector>           //Dynamic Array Class.
+#include <cstring>          //For memcpy.
+#include <bit>              //For iterating over bitboards.
+
+//Choose the widest available integer SIMD instruction set. Without one, plain loops are used.
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define NNUE_USE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define NNUE_USE_SSE2
+#endif
+
+using namespace Chess;
+
+//Network piece-index for KING, QUEEN, BISHOP, KNIGHT, ROOK, PAWN.
+static constexpr int networkPieceIndex[6] = {5,4,2,1,3,0};
+
+//Returns the feature index of a piece as seen from perspective (0: white, 1: black).
+static int featureIndex(int perspective, int colour, int type, int k)
+{
+    //The network counts squares from a1, while k starts at a8. Black sees the board mirrored.
+    const int square = (perspective == 0) ? (k ^ 56) : k;
+    const int side = (colour == perspective) ? 0 : 1;
+    return 384*side + 64*networkPieceIndex[type] + square;
+}
+
+//Add or subtract one row of the feature weights to the accumulator values.
+static void addWeights(int16_t *values, const int16_t *weights)
+{
+#if defined(NNUE_USE_AVX2)
+    for(int n=0; n<NNUE::nHidden; n+=16)
+    {
+        const __m256i v = _mm256_load_si256((const __m256i*)(values + n));
+        const __m256i w = _mm256_load_si256((const __m256i*)(weights + n));
+        _mm256_store_si256((__m256i*)(values + n), _mm256_add_epi16(v, w));
+    }
+#elif defined(NNUE_USE_SSE2)
+    for(int n=0; n<NNUE::nHidden; n+=8)
+    {
+        const __m128i v = _mm_load_si128((const __m128i*)(values + n));
+        const __m128i w = _mm_load_si128((const __m128i*)(weights + n));
+        _mm_store_si128((__m128i*)(values + n), _mm_add_epi16(v, w));
+    }
+#else
+    for(int n=0; n<NNUE::nHidden; n++)
+        values[n] += weights[n];
+#endif
+}
+
+static void subWeights(int16_t *values, const int16_t *weights)
+{
+#if defined(NNUE_USE_AVX2)
+    for(int n=0; n<NNUE::nHidden; n+=16)
+    {
+        const __m256i v = _mm256_load_si256((const __m256i*)(values + n));
+        const __m256i w = _mm256_load_si256((const __m256i*)(weights + n));
+        _mm256_store_si256((__m256i*)(values + n), _mm256_sub_epi16(v, w));
+    }
+#elif defined(NNUE_USE_SSE2)
+    for(int n=0; n<NNUE::nHidden; n+=8)
+    {
+        const __m128i v = _mm_load_si128((const __m128i*)(values + n));
+        const __m128i w = _mm_load_si128((const __m128i*)(weights + n));
+        _mm_store_si128((__m128i*)(values + n), _mm_sub_epi16(v, w));
+    }
+#else
+    for(int n=0; n<NNUE::nHidden; n++)
+        values[n] -= weights[n];
+#endif
+}
+
+//Inner product of the clipped ReLU of the accumulator values with the output weights.
+static int32_t dotClippedReLU(const int16_t *values, const int16_t *weights)
+{
+#if defined(NNUE_USE_AVX2)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i qa = _mm256_set1_epi16(NNUE::QA);
+    __m256i sum = zero;
+    for(int n=0; n<NNUE::nHidden; n+=16)
+    {
+        __m256i v = _mm256_load_si256((const __m256i*)(values + n));
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), qa);
+        const __m256i w = _mm256_load_si256((const __m256i*)(weights + n));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return _mm_cvtsi128_si32(sum128);
+#elif defined(NNUE_USE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i qa = _mm_set1_epi16(NNUE::QA);
+    __m128i sum = zero;
+    for(int n=0; n<NNUE::nHidden; n+=8)
+    {
+        __m128i v = _mm_load_si128((const __m128i*)(values + n));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), qa);
+        const __m128i w = _mm_load_si128((const __m128i*)(weights + n));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+    for(int n=0; n<NNUE::nHidden; n++)
+    {
+        const int32_t v = (values[n] < 0) ? 0 : ( (values[n] > NNUE::QA) ? NNUE::QA : values[n] );
+        sum += v * weights[n];
+    }
+    return sum;
+#endif
+}
+
+bool NNUE::loadNetwork(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+
+    constexpr std::size_t nValues = (std::size_t)nFeatures*nHidden + nHidden + 2*nHidden + 1;
+    std::vector<int16_t> buffer(nValues);
+    file.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)(nValues * sizeof(int16_t)));
+    if((std::size_t)file.gcount() != nValues * sizeof(int16_t))
+        return false;
+
+    const int16_t *data = buffer.data();
+    std::memcpy(network.featureWeights, data, sizeof(network.featureWeights));
+    data += (std::size_t)nFeatures*nHidden;
+    std::memcpy(network.featureBias, data, sizeof(network.featureBias));
+    data += nHidden;
+    std::memcpy(network.outputWeights, data, sizeof(network.outputWeights));
+    data += 2*nHidden;
+    network.outputBias = *data;
+
+    loaded = true;
+    return true;
+}
+
+const char *NNUE::simdName()
+{
+#if defined(NNUE_USE_AVX2)
+    return "AVX2";
+#elif defined(NNUE_USE_SSE2)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
+
+void NNUE::refresh(Accumulator &accumulator, const uint64_t bitboards[2][6])
+{
+    for(int perspective=0; perspective<2; perspective++)
+        std::memcpy(accumulator.values[perspective], network.featureBias, sizeof(network.featureBias));
+
+    for(int colour=0; colour<2; colour++)
+    {
+        for(int type=0; type<6; type++)
+        {
+            uint64_t pieces = bitboards[colour][type];
+            while(pieces)
+            {
+                addPiece(accumulator, colour, type, std::countr_zero(pieces));
+                pieces &= pieces - 1;
+            }
+        }
+    }
+}
+
+void NNUE::addPiece(Accumulator &accumulator, int colour, int type, int k)
+{
+    addWeights(accumulator.values[0], network.featureWeights[featureIndex(0, colour, type, k)]);
+    addWeights(accumulator.values[1], network.featureWeights[featureIndex(1, colour, type, k)]);
+}
+
+void NNUE::removePiece(Accumulator &accumulator, int colour, int type, int k)
+{
+    subWeights(accumulator.values[0], network.featureWeights[featureIndex(0, colour, type, k)]);
+    subWeights(accumulator.values[1], network.featureWeights[featureIndex(1, colour, type, k)]);
+}
+
+void NNUE::update(Accumulator &accumulator, const uint64_t before[2][6], const uint64_t after[2][6])
+{
+    for(int colour=0; colour<2; colour++)
+    {
+        for(int type=0; type<6; type++)
+        {
+            uint64_t removed = before[colour][type] & ~after[colour][type];
+            while(removed)
+            {
+                removePiece(accumulator, colour, type, std::countr_zero(removed));
+                removed &= removed - 1;
+            }
+
+            uint64_t added = after[colour][type] & ~before[colour][type];
+            while(added)
+            {
+                addPiece(accumulator, colour, type, std::countr_zero(added));
+                added &= added - 1;
+            }
+        }
+    }
+}
+
+int NNUE::evaluate(const Accumulator &accumulator, int sideToMove)
+{
+    const int64_t output = (int64_t)dotClippedReLU(accumulator.values[sideToMove], network.outputWeights[0])
+                         + (int64_t)dotClippedReLU(accumulator.values[1-sideToMove], network.outputWeights[1])
+                         + network.outputBias;
+
+    return (int)(output * scale / (QA * QB));
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>          //For fixed-size integers.
+
+//Efficiently updatable neural network (NNUE) to evaluate a board as an alternative to the handcrafted evaluation.
+//Architecture: (768 -> nHidden) x 2 -> 1, with a clipped ReLU between the two layers.
+namespace Chess::NNUE
+{
+    //Network Size.
+    constexpr int nFeatures = 768;  //2 sides (own, enemy) x 6 piece-types x 64 squares.
+    constexpr int nHidden = 256;    //Size of the first layer (the accumulator) per perspective.
+
+    //Quantisation. The evaluation in centipawns is (output * scale) / (QA * QB).
+    constexpr int QA = 255, QB = 64, scale = 400;
+
+    //The first layer of the network for both perspectives, indexed via [PColour]. Updated incrementally with every move.
+    struct alignas(32) Accumulator
+    {
+        int16_t values[2][nHidden]{};
+    };
+
+    //The quantised network weights.
+    struct alignas(32) Network
+    {
+        int16_t featureWeights[nFeatures][nHidden];
+        int16_t featureBias[nHidden];
+        int16_t outputWeights[2][nHidden];  //[0]: Side to move, [1]: other side.
+        int16_t outputBias;
+    };
+
+    //The loaded Network. Only valid if loaded is true.
+    inline Network network{};
+    inline bool loaded = false;
+
+    /*Loads the network from a local binary file of little-endian int16 values, stored in the order
+    featureWeights, featureBias, outputWeights, outputBias. Trailing padding is ignored.
+    The features are ordered as [own/enemy][Pawn, Knight, Bishop, Rook, Queen, King][square], squares counted from a1 = 0 to h8 = 63.
+    Returns false if the file could not be read.*/
+    bool loadNetwork(const char *path);
+
+    //Name of the SIMD instruction set the network uses.
+    const char *simdName();
+
+    //Reset the Accumulator to the biases and add all pieces. bitboards are indexed via [PColour][PType].
+    void refresh(Accumulator &accumulator, const uint64_t bitboards[2][6]);
+
+    //Add or remove a single piece at the square k = i + 8*j.
+    void addPiece(Accumulator &accumulator, int colour, int type, int k);
+    void removePiece(Accumulator &accumulator, int colour, int type, int k);
+
+    //Update the Accumulator of the bitboards before to the bitboards after, e.g. the Positions before and after a move. Only the changed pieces are added or removed.
+    void update(Accumulator &accumulator, const uint64_t before[2][6], const uint64_t after[2][6]);
+
+    //Evaluate the Accumulator from the perspective of sideToMove in centipawns.
+    int evaluate(const Accumulator &accumulator, int sideToMove);
+}
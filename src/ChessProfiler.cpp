@@ -0,0 +1,89 @@
+#include "ChessProfiler.h"
+#include <deque>            //Keeps the counters in place when more threads are added.
+#include <mutex>            //For adding threads.
+#include <iomanip>          //For aligning the table.
+#include <iostream>         //For printing the totals at the end.
+
+using namespace Chess;
+
+namespace
+{
+    //The counters of all threads that ever ran a Section, with the time they were started at to convert ticks to nanoseconds.
+    struct Registry
+    {
+        std::mutex mtx{};
+        std::deque<Profiler::ThreadCounters> threads{};
+        const std::uint64_t startTicks = Profiler::ticks();
+        const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    };
+
+    //Never destroyed, since worker threads may still count while the static objects are destroyed at exit.
+    Registry &registry()
+    {
+        static Registry *registry = new Registry{};
+        return *registry;
+    }
+
+#ifdef CHESS_PROFILE
+    //Prints the totals when the program ends.
+    struct PrintAtExit
+    {
+        PrintAtExit()
+        {
+            registry();
+        }
+
+        ~PrintAtExit()
+        {
+            Profiler::print(std::cout);
+        }
+    } printAtExit{};
+#endif
+}
+
+Profiler::ThreadCounters &Profiler::registerThread()
+{
+    Registry &r = registry();
+    const std::lock_guard<std::mutex> lock(r.mtx);
+    return r.threads.emplace_back();
+}
+
+void Profiler::print(std::ostream &out)
+{
+    if(!enabled)
+    {
+        out << "INFO: The profiler is disabled. Build with CHESS_PROFILE defined to enable it.\n";
+        return;
+    }
+
+    Registry &r = registry();
+    std::uint64_t calls[NSECTIONS]{}, ticks[NSECTIONS]{};
+    std::size_t nThreads = 0;
+    {
+        const std::lock_guard<std::mutex> lock(r.mtx);
+        nThreads = r.threads.size();
+        for(const ThreadCounters &counters : r.threads)
+        {
+            for(int s=0; s<NSECTIONS; s++)
+            {
+                calls[s] += counters.calls[s].load(std::memory_order_relaxed);
+                ticks[s] += counters.ticks[s].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    //Ticks per nanosecond, measured over the whole run.
+    const double elapsedTicks = (double)(Profiler::ticks() - r.startTicks);
+    const double elapsedNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - r.startTime).count();
+    const double ticksPerNs = (elapsedTicks > 0.0 && elapsedNs > 0.0) ? elapsedTicks / elapsedNs : 1.0;
+
+    out << "Profile of " << nThreads << " threads, " << std::fixed << std::setprecision(2) << ticksPerNs << " ticks per ns. Recursive calls are only timed once.\n";
+    out << std::left << std::setw(28) << "Function" << std::right << std::setw(14) << "calls" << std::setw(16) << "ticks" << std::setw(12) << "total ms" << std::setw(12) << "ns/call" << '\n';
+    for(int s=0; s<NSECTIONS; s++)
+    {
+        const double ns = ticks[s] / ticksPerNs;
+        out << std::left << std::setw(28) << sectionNames[s] << std::right << std::setw(14) << calls[s] << std::setw(16) << ticks[s]
+            << std::setw(12) << std::setprecision(1) << ns * 1e-6 << std::setw(12) << (calls[s] > 0 ? ns / calls[s] : 0.0) << '\n';
+    }
+    out << std::defaultfloat;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>           //The counters are read by other threads while they are written.
+#include <chrono>           //Fallback clock if there is no time stamp counter.
+#include <cstdint>          //Fixed-width integers for the counters.
+#include <ostream>          //For printing the totals.
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>         //For __rdtsc.
+#define CHESS_PROFILE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>      //For __rdtsc.
+#define CHESS_PROFILE_RDTSC
+#endif
+
+//Call counts and times of the hot functions of the engine, per thread, without an external profiler.
+//Only compiled in if CHESS_PROFILE is defined, otherwise PROFILE_SCOPE expands to nothing and the engine is unchanged.
+namespace Chess::Profiler
+{
+    //The functions that are timed.
+    enum Section
+    {
+        UPDATEPSEUDOLEGALMOVEMENT,
+        UPDATELEGALMOVEMENT,
+        MAKEMOVE,
+        GETBOARDWEIGHT,
+        SAVEBOARDSTATE,
+        LOADTESTBOARDSTATE,
+        CHECKGAMEOVER,
+        NEGAMAX,
+        NSECTIONS,
+    };
+
+    inline constexpr const char *sectionNames[NSECTIONS] =
+    {
+        "updatePseudoLegalMovement",
+        "updateLegalMovement",
+        "makeMove",
+        "getBoardWeight",
+        "saveBoardState",
+        "loadTestBoardState",
+        "checkGameOver",
+        "negamax",
+    };
+
+    //True if the engine was built with CHESS_PROFILE.
+#ifdef CHESS_PROFILE
+    inline constexpr bool enabled = true;
+#else
+    inline constexpr bool enabled = false;
+#endif
+
+    //The counters of a single thread. Only the owning thread writes them, so a relaxed load and store is enough and no locked instruction is needed.
+    struct ThreadCounters
+    {
+        std::atomic<std::uint64_t> calls[NSECTIONS]{};
+        std::atomic<std::uint64_t> ticks[NSECTIONS]{};
+        int active[NSECTIONS]{};        //How many calls of a Section are running, so recursive functions like negamax are only timed at the outermost call.
+    };
+
+    //Create the counters of the calling thread. They are kept until the program ends, so they can still be printed after the thread has finished.
+    ThreadCounters &registerThread();
+
+    //The counters of the calling thread.
+    inline ThreadCounters &threadCounters()
+    {
+        thread_local ThreadCounters *counters = &registerThread();
+        return *counters;
+    }
+
+    //The time stamp counter in cycles where available, otherwise nanoseconds of the steady_clock.
+    inline std::uint64_t ticks()
+    {
+#ifdef CHESS_PROFILE_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    //Counts a call of section and adds the time until the end of the scope.
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Section section): counters{threadCounters()}, section{section}
+        {
+            if(counters.active[section]++ == 0)
+                start = ticks();
+        }
+
+        ~ScopedTimer()
+        {
+            counters.calls[section].store(counters.calls[section].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if(--counters.active[section] == 0)
+                counters.ticks[section].store(counters.ticks[section].load(std::memory_order_relaxed) + ticks() - start, std::memory_order_relaxed);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer &operator=(const ScopedTimer&) = delete;
+
+    private:
+        ThreadCounters &counters;
+        const Section section;
+        std::uint64_t start = 0;
+    };
+
+    //Print the calls, the total time and the time per call of every Section, summed over all threads. Called by "d profile" and when the program ends.
+    void print(std::ostream &out);
+}
+
+#ifdef CHESS_PROFILE
+#define PROFILE_SCOPE(section) const Chess::Profiler::ScopedTimer profileScope{Chess::Profiler::section}
+#else
+#define PROFILE_SCOPE(section)
+#endif
@@ -0,0 +1,581 @@
+#include "ChessTuning.h"
+#include <fstream>          //For reading the positions and writing the header.
+#include <cmath>            //For exp and sqrt.
+
+using namespace Chess;
+
+//Parameter-Tables
+
+namespace
+{
+    //A table of evaluation constants from ChessEngine.h. Tables with fewer than 3 dimensions set the remaining ones to 1.
+    struct Table
+    {
+        const char *name;
+        const int *values;
+        int dims[3];
+        int nDims;
+
+        int size() const { return dims[0]*dims[1]*dims[2]; }
+    };
+
+    enum TableID
+    {
+        PAWNPST, KNIGHTPST, BISHOPPST, ROOKPST, QUEENPST, KINGPST,
+        PIECEVALUE,
+        ROOKMOBILITY, KNIGHTMOBILITY, BISHOPMOBILITY, QUEENMOBILITY, KINGMOBILITY,
+        PAWNDOUBLED, PAWNISOLATED, PAWNBLOCKED, PAWNBACKWARD, PAWNPASSED,
+        KINGCHECK,
+        NTABLES
+    };
+
+    //Same order as TableID.
+    const Table tables[NTABLES] =
+    {
+        {"PawnPST",         &PawnPST[0][0][0],      {2,8,8},  3},
+        {"KnightPST",       &KnightPST[0][0][0],    {2,8,8},  3},
+        {"BishopPST",       &BishopPST[0][0][0],    {2,8,8},  3},
+        {"RookPST",         &RookPST[0][0][0],      {2,8,8},  3},
+        {"QueenPST",        &QueenPST[0][0][0],     {2,8,8},  3},
+        {"KingPST",         &KingPST[0][0][0],      {2,8,8},  3},
+        {"pieceValue",      &pieceValue[0][0],      {2,6,1},  2},
+        {"RookMobility",    &RookMobility[0][0],    {2,15,1}, 2},
+        {"KnightMobility",  &KnightMobility[0][0],  {2,9,1},  2},
+        {"BishopMobility",  &BishopMobility[0][0],  {2,14,1}, 2},
+        {"QueenMobility",   &QueenMobility[0][0],   {2,28,1}, 2},
+        {"KingMobility",    &KingMobility[0][0],    {2,9,1},  2},
+        {"PawnDoubled",     &PawnDoubled[0],        {2,1,1},  1},
+        {"PawnIsolated",    &PawnIsolated[0],       {2,1,1},  1},
+        {"PawnBlocked",     &PawnBlocked[0],        {2,1,1},  1},
+        {"PawnBackward",    &PawnBackward[0],       {2,1,1},  1},
+        {"PawnPassed",      &PawnPassed[0][0],      {2,8,1},  2},
+        {"KingCheck",       &KingCheck[0],          {2,1,1},  1},
+    };
+
+    //Index of the first parameter of every table.
+    const std::array<int, NTABLES+1> tableOffset = []()
+    {
+        std::array<int, NTABLES+1> offset{};
+        for(int t=0; t<NTABLES; t++)
+            offset[t+1] = offset[t] + tables[t].size();
+        return offset;
+    }();
+
+    //Returns the parameter index of table[a][b][c].
+    int parameterIndex(TableID table, int a, int b=0, int c=0)
+    {
+        const int *dims = tables[table].dims;
+        return tableOffset[table] + (a*dims[1] + b)*dims[2] + c;
+    }
+
+    //Returns the parameter index of the evaluation constant at value, -1 if it belongs to no table.
+    int parameterIndex(const int *value)
+    {
+        const std::less<const int*> less{};
+        for(int t=0; t<NTABLES; t++)
+        {
+            if(!less(value, tables[t].values) && less(value, tables[t].values + tables[t].size()))
+                return tableOffset[t] + (int)(value - tables[t].values);
+        }
+        return -1;
+    }
+
+    //Sums the coefficients of every parameter before they are stored as Features. Terms of both colours often cancel.
+    //Receives the terms straight from the handcrafted evaluation, so the Features always match it.
+    struct FeatureCounter : EvalSink
+    {
+        std::vector<int> coefficients = std::vector<int>(tableOffset[NTABLES], 0);
+        std::vector<int> touched{};
+
+        void add(const int &value, int coefficient) override
+        {
+            //A constant outside the tables is missed and shows up as a mismatch when the TrainingSet is loaded.
+            const int index = parameterIndex(&value);
+            if(index < 0)
+                return;
+
+            if(coefficients[index] == 0)
+                touched.push_back(index);
+            coefficients[index] += coefficient;
+        }
+
+        void collect(std::vector<Tuning::Feature> &features)
+        {
+            features.clear();
+            for(int index : touched)
+            {
+                if(coefficients[index] != 0)
+                    features.push_back({(uint16_t)index, (int16_t)coefficients[index]});
+                coefficients[index] = 0;
+            }
+            touched.clear();
+        }
+    };
+
+    //Split [0,n) into nThreads contiguous ranges and call function(begin, end, threadID) for each as a task on the threadPool.
+    template<typename Function>
+    void parallelFor(std::size_t n, int nThreads, Function function)
+    {
+        nThreads = (int)std::max<std::size_t>(1, std::min<std::size_t>((std::size_t)std::max(nThreads,1), n));
+
+        TaskGroup group{};
+        for(int t=0; t<nThreads; t++)
+        {
+            const std::size_t begin = n*t/nThreads, end = n*(t+1)/nThreads;
+            threadPool.submit(group, [&function, begin, end, t]()
+            {
+                function(begin, end, t);
+            });
+        }
+        threadPool.wait(group);
+    }
+
+    //Winning chances of White for a given weight in centipawns.
+    double sigmoid(double K, double weight)
+    {
+        return 1.0 / (1.0 + std::exp(-K*weight*std::log(10.0)/400.0));
+    }
+
+    //Split a line into FEN and game result. Returns false if no result was found.
+    bool parseLine(const std::string &line, std::string &FEN, float &result)
+    {
+        const std::size_t bracket = line.find('[');
+        if(line.find("1/2-1/2") != std::string::npos)
+            result = 0.5f;
+        else if(line.find("1-0") != std::string::npos)
+            result = 1.0f;
+        else if(line.find("0-1") != std::string::npos)
+            result = 0.0f;
+        else if(bracket != std::string::npos)
+            result = std::strtof(line.c_str() + bracket + 1, nullptr);
+        else
+            return false;
+
+        //The FEN consists of the board, colour, castling and en passant, optionally followed by the two counters.
+        std::istringstream stream(line);
+        std::string field{};
+        int nFields = 0;
+        FEN.clear();
+        while(nFields < 6 && stream >> field)
+        {
+            if(nFields >= 4 && !std::all_of(field.begin(), field.end(), [](char c){ return c >= '0' && c <= '9'; }))
+                break;
+            if(nFields > 0)
+                FEN += ' ';
+            FEN += field;
+            nFields++;
+        }
+
+        return nFields >= 2;
+    }
+}
+
+int Tuning::nParameters()
+{
+    return tableOffset[NTABLES];
+}
+
+std::vector<double> Tuning::getDefaultParameters()
+{
+    std::vector<double> parameters(nParameters());
+    for(int t=0; t<NTABLES; t++)
+    {
+        for(int n=0; n<tables[t].size(); n++)
+            parameters[tableOffset[t] + n] = tables[t].values[n];
+    }
+    return parameters;
+}
+
+//Feature Extraction
+
+void Tuning::extractFeatures(const Engine &engine, std::vector<Feature> &features)
+{
+    thread_local FeatureCounter counter{};
+
+    u64 bitboards[2][6]{};
+    engine.getPieceBitboards(bitboards);
+    getHandcraftedWeight(bitboards, engine.lateGame, &counter);
+
+    counter.collect(features);
+}
+
+int Tuning::quiescence(Engine &engine, int alpha, int beta, int ply, int maxPly, ChessMove *pv, int &pvLength, Arena &arena)
+{
+    pvLength = 0;
+
+    const int sign = ((engine.turnColour == PWHITE) ? +1 : -1);
+    const int standPat = sign*engine.getBoardWeight();
+    if(standPat >= beta || ply >= maxPly || engine.turnColour == PNONE)
+        return standPat;
+    if(standPat > alpha)
+        alpha = standPat;
+
+    //Collect all captures and promotions, the most valuable victim first.
+    const Arena::Scope scope{arena};
+    const PColour colour = engine.turnColour;
+    std::pair<int, ChessMove> *captures = arena.allocate<std::pair<int, ChessMove>>(engine.nMovesPseudo[colour]);
+    int nCaptures = 0;
+    const bool lateGame = engine.lateGame;
+    for(int n=0; n<engine.nMovesPseudo[colour]; n++)
+    {
+        const ChessMove &move = engine.moveListPseudo[colour][n];
+        const ChessPiece *piece = engine.board[move.start.i][move.start.j];
+        const ChessPiece *target = engine.board[move.end.i][move.end.j];
+
+        int gain = 0;
+        if(target != nullptr)
+            gain = pieceValue[lateGame][target->type];
+        else if(piece->type == PAWN && move.start.i != move.end.i)
+            gain = pieceValue[lateGame][PAWN];
+        if(move.endType != piece->type)
+            gain += pieceValue[lateGame][move.endType] - pieceValue[lateGame][PAWN];
+
+        if(gain > 0)
+            captures[nCaptures++] = {8*gain + piece->type, move};
+    }
+    std::sort(captures, captures + nCaptures, [](const auto &a, const auto &b){ return a.first > b.first; });
+
+    engine.saveBoardState(engine.turnCounter + ply + 1);
+
+    //The principal variation below this ply has at most one move per remaining ply.
+    ChessMove *childPv = arena.allocate<ChessMove>(maxPly - ply - 1);
+    int childPvLength = 0;
+
+    for(int n=0; n<nCaptures; n++)
+    {
+        const ChessMove &move = captures[n].second;
+        if(engine.makeMove(move))
+        {
+            engine.advancePseudoTurn();
+            const int weight = -quiescence(engine, -beta, -alpha, ply+1, maxPly, childPv, childPvLength, arena);
+
+            if(weight > alpha)
+            {
+                alpha = weight;
+                pv[0] = move;
+                std::copy(childPv, childPv + childPvLength, pv + 1);
+                pvLength = childPvLength + 1;
+            }
+
+            if(weight >= beta)
+            {
+                engine.loadTestBoardState(engine.turnCounter + ply + 1);
+                return weight;
+            }
+        }
+        engine.loadTestBoardState(engine.turnCounter + ply + 1);
+    }
+
+    return alpha;
+}
+
+//Training Data
+
+bool Tuning::loadTrainingSet(const Settings &settings, TrainingSet &trainingSet)
+{
+    std::ifstream file(settings.dataFile);
+    if(!file)
+        return false;
+
+    std::vector<std::string> lines{};
+    std::string line{};
+    while(std::getline(file, line))
+    {
+        if(!line.empty())
+            lines.push_back(line);
+    }
+
+    const Timer timer{};
+    const int nThreadsUsed = std::max(1, std::min<int>(settings.nThreads, (int)lines.size()));
+    std::vector<TrainingSet> threadSets(nThreadsUsed);
+    std::vector<std::size_t> nMismatches(nThreadsUsed, 0);
+    const std::vector<double> defaultParameters = getDefaultParameters();
+
+    parallelFor(lines.size(), nThreadsUsed, [&](std::size_t begin, std::size_t end, int threadID)
+    {
+        auto engine = std::make_unique<Engine>();
+        TrainingSet &threadSet = threadSets[threadID];
+        std::vector<Feature> features{};
+        std::vector<BatchEval::Position> positions{};
+        std::vector<double> modelWeights{};
+        Arena arena{128*1024};
+        ChessMove *pv = arena.allocate<ChessMove>(std::max(settings.quiescenceDepth, 0));
+        int pvLength = 0;
+        std::string FEN{};
+        float result = 0.0f;
+
+        for(std::size_t n=begin; n<end; n++)
+        {
+            if(!parseLine(lines[n], FEN, result))
+                continue;
+
+            engine->loadFEN(FEN.c_str());
+            engine->turnCounter = 0;
+            engine->turnCounterStart = 0;
+            engine->checkLateGame();
+            engine->saveBoardState(0);
+
+            //Resolve the position and replay the principal variation to reach the quiet position.
+            quiescence(*engine, -INT_MAX, +INT_MAX, 0, settings.quiescenceDepth, pv, pvLength, arena);
+            engine->loadTestBoardState(0);
+            for(int m=0; m<pvLength; m++)
+            {
+                engine->makeMove(pv[m]);
+                engine->advancePseudoTurn();
+            }
+
+            extractFeatures(*engine, features);
+
+            double weight = 0.0;
+            for(const Feature &feature : features)
+                weight += feature.coefficient * defaultParameters[feature.index];
+            modelWeights.push_back(weight);
+            positions.push_back(BatchEval::getPosition(*engine));
+
+            threadSet.features.insert(threadSet.features.end(), features.begin(), features.end());
+            threadSet.offsets.push_back((uint32_t)threadSet.features.size());
+            threadSet.results.push_back(result);
+        }
+
+        //Score all quiet positions at once. The linear model must reproduce the handcrafted evaluation exactly.
+        threadSet.weights.resize(positions.size());
+        BatchEval::evaluate(positions.data(), positions.size(), threadSet.weights.data());
+        for(std::size_t n=0; n<positions.size(); n++)
+        {
+            if((int)modelWeights[n] != threadSet.weights[n])
+                nMismatches[threadID]++;
+        }
+    });
+
+    //Merge the positions of every thread in order.
+    trainingSet = TrainingSet{};
+    std::size_t nMismatchesTotal = 0;
+    for(int t=0; t<nThreadsUsed; t++)
+    {
+        const TrainingSet &threadSet = threadSets[t];
+        const uint32_t offset = trainingSet.offsets.back();
+        trainingSet.features.insert(trainingSet.features.end(), threadSet.features.begin(), threadSet.features.end());
+        for(std::size_t n=1; n<threadSet.offsets.size(); n++)
+            trainingSet.offsets.push_back(offset + threadSet.offsets[n]);
+        trainingSet.results.insert(trainingSet.results.end(), threadSet.results.begin(), threadSet.results.end());
+        trainingSet.weights.insert(trainingSet.weights.end(), threadSet.weights.begin(), threadSet.weights.end());
+        nMismatchesTotal += nMismatches[t];
+    }
+
+    std::cout << "INFO: Loaded " << trainingSet.size() << " of " << lines.size() << " positions in " << timer.getTime() << "s.\n";
+    if(nMismatchesTotal > 0)
+        std::cerr << "WARNING Tuning: " << nMismatchesTotal << " positions differ from the handcrafted evaluation!\n";
+
+    return true;
+}
+
+//Gradient Descent
+
+void Tuning::evaluate(const TrainingSet &trainingSet, const std::vector<double> &parameters, std::vector<double> &weights, int nThreads)
+{
+    weights.resize(trainingSet.size());
+
+    parallelFor(trainingSet.size(), nThreads, [&](std::size_t begin, std::size_t end, int)
+    {
+        for(std::size_t n=begin; n<end; n++)
+        {
+            double weight = 0.0;
+            for(uint32_t f=trainingSet.offsets[n]; f<trainingSet.offsets[n+1]; f++)
+                weight += trainingSet.features[f].coefficient * parameters[trainingSet.features[f].index];
+            weights[n] = weight;
+        }
+    });
+}
+
+double Tuning::computeLoss(const TrainingSet &trainingSet, const std::vector<double> &weights, double K)
+{
+    if(trainingSet.size() == 0)
+        return 0.0;
+
+    double loss = 0.0;
+    for(std::size_t n=0; n<trainingSet.size(); n++)
+    {
+        const double error = trainingSet.results[n] - sigmoid(K, weights[n]);
+        loss += error*error;
+    }
+    return loss / trainingSet.size();
+}
+
+double Tuning::fitScalingConstant(const TrainingSet &trainingSet, const std::vector<double> &weights)
+{
+    //Golden-section search, the loss has a single minimum in K.
+    const double ratio = 0.5*(std::sqrt(5.0) - 1.0);
+    double a = 0.01, b = 5.0;
+    double c = b - ratio*(b-a), d = a + ratio*(b-a);
+
+    for(int n=0; n<60; n++)
+    {
+        if(computeLoss(trainingSet, weights, c) < computeLoss(trainingSet, weights, d))
+            b = d;
+        else
+            a = c;
+        c = b - ratio*(b-a);
+        d = a + ratio*(b-a);
+    }
+
+    return 0.5*(a+b);
+}
+
+void Tuning::computeGradient(const TrainingSet &trainingSet, const std::vector<double> &weights, double K, std::vector<double> &gradient, int nThreads)
+{
+    const int nThreadsUsed = std::max(1, std::min<int>(nThreads, (int)std::max<std::size_t>(trainingSet.size(), 1)));
+    std::vector<std::vector<double>> threadGradients(nThreadsUsed, std::vector<double>(nParameters(), 0.0));
+    const double factor = K*std::log(10.0)/400.0;
+
+    parallelFor(trainingSet.size(), nThreadsUsed, [&](std::size_t begin, std::size_t end, int threadID)
+    {
+        std::vector<double> &threadGradient = threadGradients[threadID];
+        for(std::size_t n=begin; n<end; n++)
+        {
+            //Derivative of (result - sigmoid)^2 with respect to the weight.
+            const double s = sigmoid(K, weights[n]);
+            const double dLoss = -2.0*(trainingSet.results[n] - s)*s*(1.0-s)*factor;
+
+            for(uint32_t f=trainingSet.offsets[n]; f<trainingSet.offsets[n+1]; f++)
+                threadGradient[trainingSet.features[f].index] += dLoss * trainingSet.features[f].coefficient;
+        }
+    });
+
+    gradient.assign(nParameters(), 0.0);
+    for(const auto &threadGradient : threadGradients)
+    {
+        for(int p=0; p<nParameters(); p++)
+            gradient[p] += threadGradient[p] / std::max<std::size_t>(trainingSet.size(), 1);
+    }
+}
+
+//Output
+
+bool Tuning::writeHeader(const char *path, const std::vector<double> &parameters)
+{
+    std::ofstream file(path);
+    if(!file)
+        return false;
+
+    file << "#pragma once\n\n";
+    file << "//Evaluation constants generated by the Texel-Tuning mode. Replace the corresponding tables in ChessEngine.h with them.\n";
+    file << "namespace Chess\n{\n";
+
+    for(int t=0; t<NTABLES; t++)
+    {
+        const Table &table = tables[t];
+        auto value = [&](int a, int b, int c){ return (int)std::lround(parameters[parameterIndex((TableID)t, a, b, c)]); };
+
+        file << "    inline constexpr int " << table.name;
+        for(int d=0; d<table.nDims; d++)
+            file << "[" << table.dims[d] << "]";
+
+        switch(table.nDims)
+        {
+        case 1:
+            file << " = {" << value(0,0,0) << "," << value(1,0,0) << "};\n\n";
+            break;
+
+        case 2:
+            file << " =\n    {\n";
+            for(int a=0; a<table.dims[0]; a++)
+            {
+                file << "        {";
+                for(int b=0; b<table.dims[1]; b++)
+                    file << value(a,b,0) << ((b+1 < table.dims[1]) ? "," : "");
+                file << "}" << ((a+1 < table.dims[0]) ? "," : "") << "\n";
+            }
+            file << "    };\n\n";
+            break;
+
+        case 3:
+            file << " =\n    {\n";
+            for(int a=0; a<table.dims[0]; a++)
+            {
+                file << "        {\n";
+                for(int b=0; b<table.dims[1]; b++)
+                {
+                    file << "            {";
+                    for(int c=0; c<table.dims[2]; c++)
+                        file << value(a,b,c) << ((c+1 < table.dims[2]) ? "," : "");
+                    file << "}" << ((b+1 < table.dims[1]) ? "," : "") << "\n";
+                }
+                file << "        }" << ((a+1 < table.dims[0]) ? "," : "") << "\n";
+            }
+            file << "    };\n\n";
+            break;
+        }
+    }
+
+    file << "}\n";
+    return (bool)file;
+}
+
+//Headless Mode
+
+int Tuning::run(int argc, char *argv[])
+{
+    if(argc < 1)
+    {
+        std::cout << "Usage: tune [data-file] [epochs] [output-header]\n";
+        return 1;
+    }
+
+    Settings settings{};
+    settings.dataFile = argv[0];
+    if(argc > 1)
+        settings.epochs = std::max(0, std::atoi(argv[1]));
+    if(argc > 2)
+        settings.outputFile = argv[2];
+
+    Chess::initialize();
+    evalType = HANDCRAFTEDEVAL;
+
+    TrainingSet trainingSet{};
+    if(!loadTrainingSet(settings, trainingSet) || trainingSet.size() == 0)
+    {
+        std::cerr << "ERROR Tuning: Could not load any positions from " << settings.dataFile << "!\n";
+        return 1;
+    }
+
+    //The current constants are fitted against the weights scored while loading.
+    std::vector<double> parameters = getDefaultParameters(), weights(trainingSet.weights.begin(), trainingSet.weights.end()), gradient{};
+    const double K = fitScalingConstant(trainingSet, weights);
+    std::cout << "INFO: K = " << K << ", initial loss = " << computeLoss(trainingSet, weights, K) << "\n";
+
+    //Adam-Optimizer: Every parameter gets its own step size, since some Features are far rarer than others.
+    constexpr double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    std::vector<double> momentum(nParameters(), 0.0), velocity(nParameters(), 0.0);
+    const Timer timer{};
+
+    for(int epoch=1; epoch<=settings.epochs; epoch++)
+    {
+        evaluate(trainingSet, parameters, weights, settings.nThreads);
+        computeGradient(trainingSet, weights, K, gradient, settings.nThreads);
+
+        for(int p=0; p<nParameters(); p++)
+        {
+            momentum[p] = beta1*momentum[p] + (1.0-beta1)*gradient[p];
+            velocity[p] = beta2*velocity[p] + (1.0-beta2)*gradient[p]*gradient[p];
+            const double momentumHat = momentum[p] / (1.0 - std::pow(beta1, epoch));
+            const double velocityHat = velocity[p] / (1.0 - std::pow(beta2, epoch));
+            parameters[p] -= settings.learningRate * momentumHat / (std::sqrt(velocityHat) + epsilon);
+        }
+
+        if(epoch % 50 == 0 || epoch == settings.epochs)
+        {
+            const double time = timer.getTime();
+            std::cout << "INFO: Epoch " << epoch << ", loss = " << computeLoss(trainingSet, weights, K)
+                      << ", positions/s = " << (std::size_t)(epoch*trainingSet.size() / std::max(time, 1e-9)) << "\n";
+        }
+    }
+
+    if(!writeHeader(settings.outputFile.c_str(), parameters))
+    {
+        std::cerr << "ERROR Tuning: Could not write " << settings.outputFile << "!\n";
+        return 1;
+    }
+    std::cout << "INFO: Tuned weights written to " << settings.outputFile << ".\n";
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "ChessEngine.h"
+#include "ChessBatchEval.h"
+#include <cstdint>          //For fixed-size integers.
+
+//Texel-Tuning of the handcrafted evaluation: Fits all evaluation constants to the results of labelled positions via gradient descent.
+//The handcrafted evaluation is linear in its constants, so every position is reduced once to a sparse list of Features.
+namespace Chess::Tuning
+{
+    //A single evaluation constant and how often it is counted. The evaluation is the sum of coefficient*parameter[index].
+    struct Feature
+    {
+        uint16_t index{};
+        int16_t coefficient{};
+    };
+
+    //The quiescence-resolved positions, stored contiguously.
+    struct TrainingSet
+    {
+        std::vector<Feature> features{};
+        std::vector<uint32_t> offsets{0};   //The Features of position n lie within [offsets[n], offsets[n+1]).
+        std::vector<float> results{};       //Game result from the perspective of White: 1, 0.5 or 0.
+        std::vector<int> weights{};         //Weight with the current evaluation constants, scored via BatchEval.
+
+        std::size_t size() const { return results.size(); }
+    };
+
+    struct Settings
+    {
+        std::string dataFile{}, outputFile{"TunedWeights.h"};
+        int epochs = 1000;              //Number of gradient descent steps over the whole TrainingSet.
+        double learningRate = 1.0;      //Step size in centipawns.
+        int quiescenceDepth = 8;        //Maximum number of captures to resolve a position.
+        int nThreads = Chess::nThreads;
+    };
+
+    //Number of tunable evaluation constants.
+    int nParameters();
+
+    //The current evaluation constants from ChessEngine.h.
+    std::vector<double> getDefaultParameters();
+
+    //Fill features with the Features of the current Board, taken from the terms of the handcrafted evaluation via an EvalSink.
+    void extractFeatures(const Engine &engine, std::vector<Feature> &features);
+
+    //Search all captures until the Board is quiet. Returns the weight for the side to move and stores the pvLength moves of the principal variation in pv.
+    //pv needs room for maxPly-ply moves. The capture lists and principal variations of every ply are taken from arena, which must be owned by the calling thread.
+    int quiescence(Engine &engine, int alpha, int beta, int ply, int maxPly, ChessMove *pv, int &pvLength, Arena &arena);
+
+    /*Loads the labelled positions from a text file with one position per line: a FEN followed by the game result,
+    either as "1-0", "0-1", "1/2-1/2" (quotes optional) or as a number in [1.0], [0.5], [0.0]. Every position is resolved via quiescence.
+    The quiet positions are scored in batches via BatchEval and checked against the Features. Returns false if the file could not be read.*/
+    bool loadTrainingSet(const Settings &settings, TrainingSet &trainingSet);
+
+    //Evaluate every position of the TrainingSet in parallel with the given parameters.
+    void evaluate(const TrainingSet &trainingSet, const std::vector<double> &parameters, std::vector<double> &weights, int nThreads);
+
+    //Mean squared error between the results and the predicted winning chances sigmoid(K*weight).
+    double computeLoss(const TrainingSet &trainingSet, const std::vector<double> &weights, double K);
+
+    //Find the scaling constant K that minimizes the loss for the given weights.
+    double fitScalingConstant(const TrainingSet &trainingSet, const std::vector<double> &weights);
+
+    //Gradient of the loss with respect to every parameter, summed in parallel.
+    void computeGradient(const TrainingSet &trainingSet, const std::vector<double> &weights, double K, std::vector<double> &gradient, int nThreads);
+
+    //Write the parameters as a header with the same tables as ChessEngine.h. Returns false if the file could not be written.
+    bool writeHeader(const char *path, const std::vector<double> &parameters);
+
+    //Headless tuning mode. Arguments: [data-file] [epochs] [output-header]. Returns the exit status.
+    int run(int argc, char *argv[]);
+}
@@ -2,6 +2,7 @@
 #include "Raylib_GameHeader.h"
 #include "LevelChessboard.h"
 #include "LevelSetupChessboard.h"
+#include <fstream>          //For reading EPD-Files.
 
 using namespace Chess;
 
@@ -11,18 +12,18 @@ void ChessUCI::inputUCI()
     {
         std::getline( std::cin, inputString );
 
-        cleanUpThreads();
-
         //Commands with no Parameters or Options
         if(stopMainThread.load() || inputString == "exit" || inputString == "quit" || inputString == "q" || inputString == "close")
         {
             stopAllThreads();
+            if(!traceFile.empty())
+                Trace::stop(traceFile);
             stopMainThread.store(true);
             Raylib::Window.active = false;
         }
 
         else if(inputString == "stop")
-            stopAllThreads();
+            stopSearches();
 
         else if(inputString == "isready")
             std::cout << "readyok\n";
@@ -30,23 +31,48 @@ void ChessUCI::inputUCI()
         else if(inputString == "help" || inputString == "h")
             executeHelpCommand();
 
-        else if(UCIsetCommandParameters("d", {"board","movementrange","attackrange"}) || UCIsetCommandParameters("display", {"board","movementrange","attackrange"}))
+        else if(UCIsetCommandParameters("d", {"board","movementrange","attackrange","profile","searchstats"}) || UCIsetCommandParameters("display", {"board","movementrange","attackrange","profile","searchstats"}))
             executeDisplayCommand();
 
+        else if(UCIsetCommandParameters("setoption", {"name","value"}))
+            executeSetOptionCommand();
+
         else if(UCIsetCommandParameters("position", {"startpos","testpos","fen","moves"}))
             executePositionCommand();
 
-        else if(UCIsetCommandParameters("perft", {"depth", "searchmoves"}))
+        else if(UCIsetCommandParameters("perft suite", {"depth", "file"}))
+            executePerftSuiteCommand();
+
+        else if(UCIsetCommandParameters("perft", {"depth", "searchmoves", "nobulk"}))
             executePerftCommand();
 
-        else if(UCIsetCommandParameters("go", {"depth", "searchmoves", "bottype"}))
+        else if(UCIsetCommandParameters("go", {"depth", "searchmoves", "bottype", "movetime", "nodes"}))
             executeGoCommand();
 
+        else if(UCIsetCommandParameters("bench", {"depth"}))
+            executeBenchCommand();
+
         else
             std::cout << "Unknown command.\n";
     }
 }
 
+void ChessUCI::stopSearches()
+{
+    stopToken.cancel();
+    searchRequest.wait();
+    threadPool.wait(jobs);
+    stopToken.reset();
+}
+
+void ChessUCI::waitForSearches()
+{
+    searchRequest.wait();
+    threadPool.wait(jobs);
+    for(const Bot &bot : botList)
+        bot.wait();
+}
+
 bool ChessUCI::UCIsetCommandParameters(std::string_view command, std::vector<std::string_view> options)
 {
     if(inputString.substr(0, command.length()) != command)
@@ -111,7 +137,7 @@ void ChessUCI::executeHelpCommand()
     std::cout << "\tClose the program.\n\n";
     
     std::cout << "\'stop\':\n";
-    std::cout << "\tAbort all ongoing calculations.\n\n";
+    std::cout << "\tAbort all searches and perft-tests started via the console. Bots playing in the window keep searching.\n\n";
 
 
     std::cout << "\'go\':\n";
@@ -126,6 +152,9 @@ void ChessUCI::executeHelpCommand()
 
     std::cout << "\'go bottype [bot-name]\':\n";
     std::cout << "\tLet one of the other bots determine the next move.\n";
+
+    std::cout << "\'go movetime [milliseconds]\' and \'go nodes [nodes]\':\n";
+    std::cout << "\tStop the search after the given time or number of nodes. Can be combined with the other go commands.\n";
     std::cout << '\n';
 
 
@@ -158,6 +187,40 @@ void ChessUCI::executeHelpCommand()
 
     std::cout << "\'d attackrange\' or \'display attackrange\':\n";
     std::cout << "\tDisplay the attack range of all chesspieces.\n";
+
+    std::cout << "\'d searchstats\' or \'display searchstats\':\n";
+    std::cout << "\tDisplay the nodes per ply, branching factor, fail-high rate and share of leaf nodes of the last go command. Needs a build with CHESS_SEARCH_STATS defined.\n";
+
+    std::cout << "\'d profile\' or \'display profile\':\n";
+    std::cout << "\tDisplay the calls and time spent in the hot functions of the engine, summed over all threads. Needs a build with CHESS_PROFILE defined.\n";
+    std::cout << '\n';
+
+
+    std::cout << "\'setoption name EvalFile value [path]\':\n";
+    std::cout << "\tLoad the weights of the neural network evaluation (NNUE) from a local file.\n";
+    std::cout << "\'setoption name Eval value [hce/nnue]\':\n";
+    std::cout << "\tChoose between the handcrafted evaluation and the NNUE.\n";
+    std::cout << "\'setoption name CopyMake value [true/false]\':\n";
+    std::cout << "\tLet go and perft search on compact positions that are copied for every move, instead of making and unmaking moves on a board.\n";
+    std::cout << "\'setoption name PerftHash value [MB]\':\n";
+    std::cout << "\tSize of the hash table that lets perft count transposed positions only once. 0 disables it.\n";
+    std::cout << "\'setoption name PerftSplitDepth value [plies]\':\n";
+    std::cout << "\tSplit perft-Tests into one task per position this many plies below the root, so all threads stay busy.\n";
+    std::cout << "\'setoption name Affinity value [cpus]\':\n";
+    std::cout << "\tPin the worker threads to a list of CPUs such as 0-3,6, one CPU per worker. \'all\' lets them run on every CPU again.\n";
+    std::cout << "\'setoption name WorkerNice value [0-19]\':\n";
+    std::cout << "\tLower the priority of the worker threads, so the GUI stays responsive while they search.\n";
+    std::cout << "\'setoption name PerfCounters value [true/false]\':\n";
+    std::cout << "\tMeasure perft and bench with the hardware counters of the CPU and print the instructions per cycle and misses per node. Only on Linux.\n";
+    std::cout << "\'setoption name Trace value [file/off]\':\n";
+    std::cout << "\tRecord a timeline of the work of every thread (root moves, perft subtrees, waits). \'off\' writes it to the file as Chrome trace events.\n";
+    std::cout << "\'setoption name Seed value [seed]\':\n";
+    std::cout << "\tSeed the random moves of the bots, so games can be replayed exactly. A seed of 0 makes them random again.\n";
+    std::cout << '\n';
+
+
+    std::cout << "\'bench depth [depth-value]\':\n";
+    std::cout << "\tSearch 40 fixed positions with depth (default 4) and print the total nodes, time and nodes/s. The nodes only change if the search changes.\n";
     std::cout << '\n';
 
 
@@ -165,9 +228,212 @@ void ChessUCI::executeHelpCommand()
     std::cout << "\tPerform a perft-search to find the number of available positions after depth moves.\n";
     std::cout << "\'perft depth [depth-value] searchmoves [move1] [move2] ...\':\n";
     std::cout << "\tPerform a perft-search limited to a list of moves.\n";
+    std::cout << "\'perft suite depth [max-depth] file [epd-file]\':\n";
+    std::cout << "\tCount the 6 testpositions and the positions of an optional EPD-file up to max-depth and check the results. Both options are optional.\n";
+    std::cout << "\'perft depth [depth-value] nobulk\':\n";
+    std::cout << "\tMake every move of the last ply instead of only counting the legal moves, and do not use the perft hash table. Slower, but tests makeMove as well.\n";
     std::cout << '\n';
 }
 
+void ChessUCI::executeSetOptionCommand()
+{
+    enum SetOptionOptions
+    {
+        NAME,
+        VALUE,
+    };
+
+    const std::string name = trimParameter(inputParameters[NAME]);
+    const std::string value = trimParameter(inputParameters[VALUE]);
+
+    if(name == "NO_OPTION" || name == "NO_PARAMETER")
+    {
+        std::cout << "ERROR: No option name given!\n";
+        return;
+    }
+
+    if(name == "EvalFile")
+    {
+        //The network must not change while a search or a GUI Bot evaluates with it.
+        waitForSearches();
+        if(NNUE::loadNetwork(value.c_str()))
+        {
+            std::cout << "info string NNUE loaded from " << value << ", SIMD: " << NNUE::simdName() << '\n';
+            if(useNNUE())
+                mainEngine.refreshAccumulator();
+        }
+        else
+            std::cout << "ERROR: Could not read the network file " << value << "!\n";
+    }
+    else if(name == "Eval")
+    {
+        //A running search must not switch the evaluation halfway.
+        waitForSearches();
+        if(value == "hce")
+            evalType = HANDCRAFTEDEVAL;
+        else if(value == "nnue")
+        {
+            evalType = NNUEEVAL;
+            if(!NNUE::loaded)
+                std::cout << "info Warning: No network loaded yet! The handcrafted evaluation will be used until EvalFile is set.\n";
+            else
+                mainEngine.refreshAccumulator();
+        }
+        else
+            std::cout << "ERROR: Unknown evaluation! Use hce or nnue.\n";
+    }
+    else if(name == "CopyMake")
+    {
+        //Searches read the option when they start, perft-Tests for every subtree.
+        waitForSearches();
+        if(value == "true")
+            copyMakeSearch = true;
+        else if(value == "false")
+            copyMakeSearch = false;
+        else
+            std::cout << "ERROR: Unknown value! Use true or false.\n";
+    }
+    else if(name == "PerftHash")
+    {
+        try
+        {
+            const int sizeMB = std::stoi(value);
+            if(sizeMB < 0)
+                std::cout << "ERROR: The size must not be negative!\n";
+            else
+            {
+                //The table must not change while a perft-Test uses it.
+                threadPool.wait(jobs);
+                perftTable.resize(sizeMB);
+                std::cout << "info string PerftHash " << perftTable.sizeMB() << " MB\n";
+            }
+        }
+        catch(...)
+        {
+            std::cout << "ERROR: The size must be an integer!\n";
+        }
+    }
+    else if(name == "PerftSplitDepth")
+    {
+        try
+        {
+            const int plies = std::stoi(value);
+            if(plies < 1)
+                std::cout << "ERROR: The split depth must be at least 1!\n";
+            else
+                perftSplitDepth = plies;
+        }
+        catch(...)
+        {
+            std::cout << "ERROR: The split depth must be an integer!\n";
+        }
+    }
+    else if(name == "Affinity")
+    {
+        //Parse a list like 0-3,6 into the CPUs 0 1 2 3 6.
+        std::vector<int> cpus{};
+        bool valid = true;
+        if(value != "all")
+        {
+            std::stringstream stream(value);
+            std::string range{};
+            while(valid && std::getline(stream, range, ','))
+            {
+                try
+                {
+                    const std::size_t dash = range.find('-');
+                    const int first = std::stoi(range.substr(0, dash));
+                    const int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash+1));
+                    for(int cpu=first; cpu<=last; cpu++)
+                        cpus.push_back(cpu);
+                }
+                catch(...)
+                {
+                    valid = false;
+                }
+            }
+        }
+
+        if(!valid || (cpus.empty() && value != "all"))
+            std::cout << "ERROR: Invalid CPU list! Use e.g. 0-3,6 or all.\n";
+        else if(!threadPool.setAffinity(cpus))
+            std::cout << "ERROR: Could not pin the workers to these CPUs!\n";
+        std::cout << "info string " << threadPool.topology() << '\n';
+    }
+    else if(name == "WorkerNice")
+    {
+        try
+        {
+            const int nice = std::stoi(value);
+            if(nice < 0 || nice > 19)
+                std::cout << "ERROR: The nice value must lie within 0-19!\n";
+            else if(!threadPool.setNice(nice))
+                std::cout << "ERROR: Could not change the priority of the workers! Raising it again may require privileges.\n";
+        }
+        catch(...)
+        {
+            std::cout << "ERROR: The nice value must be an integer!\n";
+        }
+        std::cout << "info string " << threadPool.topology() << '\n';
+    }
+    else if(name == "PerfCounters")
+    {
+        if(value == "true")
+            perfCounters = true;
+        else if(value == "false")
+            perfCounters = false;
+        else
+            std::cout << "ERROR: Unknown value! Use true or false.\n";
+    }
+    else if(name == "Trace")
+    {
+        if(value == "off")
+        {
+            if(traceFile.empty())
+                std::cout << "ERROR: No timeline is being recorded!\n";
+            else if(Trace::stop(traceFile))
+                std::cout << "info string Timeline written to " << traceFile << '\n';
+            else
+                std::cout << "ERROR: Could not write " << traceFile << "!\n";
+            traceFile.clear();
+        }
+        else if(!value.empty() && value != "NO_OPTION" && value != "NO_PARAMETER")
+        {
+            traceFile = value;
+            Trace::start();
+            std::cout << "info string Recording the timeline. \'setoption name Trace value off\' writes it to " << traceFile << '\n';
+        }
+        else
+            std::cout << "ERROR: Specify a file or off!\n";
+    }
+    else if(name == "Seed")
+    {
+        try
+        {
+            //A running search must not reseed its threads with a different seed halfway.
+            const uint64_t seed = std::stoull(value);
+            waitForSearches();
+            Random::setMasterSeed(seed);
+        }
+        catch(...)
+        {
+            std::cout << "ERROR: The seed must be a non-negative integer!\n";
+        }
+    }
+    else
+        std::cout << "ERROR: Unknown option " << name << "!\n";
+}
+
+std::string ChessUCI::trimParameter(const std::string &parameter)
+{
+    const std::size_t start = parameter.find_first_not_of(" \t");
+    if(start == std::string::npos)
+        return "";
+
+    const std::size_t end = parameter.find_last_not_of(" \t");
+    return parameter.substr(start, end - start + 1);
+}
+
 void ChessUCI::executeDisplayCommand()
 {
     enum DisplayOptions
@@ -175,9 +441,11 @@ void ChessUCI::executeDisplayCommand()
         BOARD,
         DANGERZONES,
         ATTACKZONES,
+        PROFILE,
+        SEARCHSTATS,
     };
 
-    if(inputParameters[BOARD] != "NO_OPTION" || (inputParameters[DANGERZONES] == "NO_OPTION" && inputParameters[ATTACKZONES] == "NO_OPTION") )
+    if(inputParameters[BOARD] != "NO_OPTION" || (inputParameters[DANGERZONES] == "NO_OPTION" && inputParameters[ATTACKZONES] == "NO_OPTION" && inputParameters[PROFILE] == "NO_OPTION" && inputParameters[SEARCHSTATS] == "NO_OPTION") )
         mainEngine.printChessboard();
 
     if(inputParameters[DANGERZONES] != "NO_OPTION")
@@ -190,6 +458,18 @@ void ChessUCI::executeDisplayCommand()
         mainEngine.updateAttackZone();
         mainEngine.printAttackZones();
     }
+
+    if(inputParameters[PROFILE] != "NO_OPTION")
+        Profiler::print(std::cout);
+
+    if(inputParameters[SEARCHSTATS] != "NO_OPTION")
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if(searchStatsEnabled)
+            lastSearchStats.print(std::cout);
+        else
+            std::cout << "INFO: The search statistics are disabled. Build with CHESS_SEARCH_STATS defined to enable them.\n";
+    }
 }
 
 void ChessUCI::executePositionCommand()
@@ -212,36 +492,13 @@ void ChessUCI::executePositionCommand()
         {
             const int testpos = std::stoi(inputParameters[TESTPOS]);
 
-            switch(testpos)
+            if(testpos < 1 || testpos > (int)testPositions.size())
             {
-            case 1:
-                mainEngine.loadFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ");                    //Position 1, Standard.
-                break;
-
-            case 2:
-                mainEngine.loadFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ");           //Position 2, Kiwipete, for testing casteling.
-                break;
-
-            case 3:
-                mainEngine.loadFEN("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");                                   //Position 3, for testing en-passant.
-                break;
-
-            case 4:
-                mainEngine.loadFEN("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");            //Position 4, for testing promotions.
-                break;
-
-            case 5:
-                mainEngine.loadFEN("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");                   //Position 5.
-                break;
-
-            case 6:
-                mainEngine.loadFEN("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");    //Position 6.
-                break;
-
-            default:
                 std::cout << "ERROR: There are only 6 Testpositions available!\n";
                 return;
             }
+
+            mainEngine.loadFEN(testPositions[testpos-1].FEN.c_str());
         }
 
         catch(const std::invalid_argument &e)
@@ -401,6 +658,7 @@ void ChessUCI::executePerftCommand()
     {
         //Get the requested Depth.
         const int depth = std::stoi(inputParameters[0]);
+        const bool bulkCounting = (inputParameters[2] == "NO_OPTION");
 
         //Get the requested MoveList.
         std::vector<ChessMove> moveList{};
@@ -417,18 +675,11 @@ void ChessUCI::executePerftCommand()
             }
         }
 
-        //Lambda to create a thread
-        auto createThread
-        {
-            [depth, moveList]() mutable
-            {
-                perftMainThread(depth, Chess::nThreads, moveList, threadList.size()-1);
-            }
-        };
-
         //Initalize the perft-Search.
-        threadDone.emplace_back(false);
-        threadList.emplace_back(createThread);
+        threadPool.submit(jobs, [depth, moveList, bulkCounting]()
+        {
+            perftMainThread(depth, moveList, bulkCounting);
+        });
     }
 
     catch(const std::invalid_argument &e)
@@ -444,170 +695,385 @@ void ChessUCI::executePerftCommand()
     }
 }
 
-void ChessUCI::perftMainThread(const int depth, int nCores, const std::vector<ChessMove> &moveList, const std::size_t threadID)
+void ChessUCI::perftMainThread(const int depth, const std::vector<ChessMove> &moveList, bool bulkCounting)
 {
-    threadDone[threadID] = false;
-
-    if(nCores <= 0)
-        nCores = 1;
+    const int splitDepth = std::max(1, perftSplitDepth.load());
 
     mtx.lock();
     const double tStart = Chess::CLOCK.getTime();
-    std::cout << "info string Threads used: " << nCores << '\n';
+    std::cout << "info string Threads used: " << threadPool.size() << ", split depth: " << splitDepth << '\n';
     mtx.unlock();
 
-    //Vector to store the results in.
-    std::vector<PerftResult> perftResults;
+    PerfCounters counters{};
+    startPerfCounters(counters);
 
-    //If only one Core is used, creating a new thread is unnecessary.
+    Trace::Scope scope{"perft", "perft"};
+    scope.addArg("depth", depth);
+
+    //Every subtree at splitDepth becomes its own task, so idle workers steal subtrees of heavy moves instead of waiting for them.
     const int nMoves = (int)moveList.size();
-    if(nCores == 1 || nMoves < nCores)
+    const Position root = mainEngine.getPosition();
+    std::unique_ptr<std::atomic<u64>[]> nodes{new std::atomic<u64>[nMoves]{}};
+    CancelToken token{&stopToken};
+    TaskGroup group{};
+
+    for(int m=0; m<nMoves; m++)
     {
-        perftTest(depth, moveList, perftResults, 0);
+        Position next;
+        if(depth >= 1 && root.makeMove(moveList[m], next))
+            perftSplit(depth-1, splitDepth-1, next, nodes[m], group, token, bulkCounting);
+    }
 
-        //Print the Results
-        std::lock_guard<std::mutex> lock(mtx);
-        if(stopThread.load())
-            std::cout << "Search aborted! Nodes found so far:\n";
+    //Wait for all tasks to finish. The calling worker helps with the perft-Tests meanwhile.
+    threadPool.wait(group);
 
-        u64 sum = 0;
-        const std::size_t nMovesFound = perftResults.size();
-        for(std::size_t m=0; m<nMovesFound; m++)
-        {
-            sum += perftResults[m].nodes;
-        }
-
-        const double time = Chess::CLOCK.getTime() - tStart;
-        std::cout << "\nNodes:\t" << sum << '\n';
-        std::cout << "Time:\t" << time << "s\n";
-        std::cout << "Speed:\t" << sum/time << " nodes/s\n\n";
+    //Print the Results
+    std::lock_guard<std::mutex> lock(mtx);
+    if(token.isCancelled())
+        std::cout << "Search aborted! Nodes found so far:\n";
 
-        threadDone[threadID] = true;
+    u64 sum = 0;
+    for(int m=0; m<nMoves; m++)
+    {
+        const PerftResult result{nodes[m].load(), moveList[m]};
+        mainEngine.printMove(result.move);
+        std::cout << ": " << result.nodes << '\n';
+        sum += result.nodes;
     }
 
-    //New ThreadList to do the perft-test with.
-    std::vector<std::thread> perftThreadList;
+    const double time = Chess::CLOCK.getTime() - tStart;
+    std::cout << "\nNodes:\t" << sum << '\n';
+    std::cout << "Time:\t" << time << "s\n";
+    std::cout << "Speed:\t" << sum/time << " nodes/s\n";
+    printPerfCounters(counters, sum);
+    std::cout << '\n';
+}
 
-    //Distribute the Moves among the Cores.
-    const int movesPerCore = nMoves/nCores;
-    int movesLeft = nMoves - (movesPerCore * nCores);
-    int offset = 0;
+void ChessUCI::perftSplit(int depth, int splitPly, const Position &position, std::atomic<u64> &nodes, TaskGroup &group, CancelToken &token, bool bulkCounting)
+{
+    if(depth <= 0)
+    {
+        nodes += 1;
+        return;
+    }
 
-    for(std::size_t n=0; n<nCores; n++)
+    //Expand the Position further.
+    if(splitPly > 0 && depth > 1)
     {
-        //Determine how many Moves this Core should handle.
-        int nMovesCore = movesPerCore;
-        if(movesLeft > 0)
+        MoveList moveList;
+        position.generateMoves(moveList);
+        for(const ChessMove &move : moveList)
         {
-            ++nMovesCore;
-            --movesLeft;
+            Position next;
+            if(position.makeMove(move, next))
+                perftSplit(depth-1, splitPly-1, next, nodes, group, token, bulkCounting);
         }
+        return;
+    }
 
-        //Create the Move-List.
-        std::vector<ChessMove> moveListCore(nMovesCore);
-        for(std::size_t m=0; m<nMovesCore; m++)
+    threadPool.submit(group, [depth, position, &nodes, &token, bulkCounting]()
+    {
+        Trace::Scope scope{"perft subtree", "perft"};
+        scope.addArg("depth", depth);
+        NodeCounter counter{token};
+        if(counter.isStopped())
+            return;
+
+        u64 result = 0;
+        if(copyMakeSearch)
+            result = perftDepthTest(depth, position, counter, bulkCounting);
+        else
         {
-            moveListCore[m] = moveList[m + offset];
+            //Board on which the perft-Test will be made.
+            EnginePool::Handle engine = enginePool.acquire();
+            engine->loadPosition(position);
+            engine->turnCounter = 0;
+            engine->turnCounterStart = 0;
+
+            const PColour c = engine->turnColour;
+            const MoveList moveList(engine->moveListPseudo[c], engine->moveListPseudo[c] + engine->nMovesPseudo[c]);
+            result = perftDepthTest(depth, depth, moveList, *engine, counter, bulkCounting);
         }
-        offset += nMovesCore;
+        nodes += result;
+    });
+}
 
-        //Lambda to create a thread
-        auto createThread
-        {
-            [depth, moveListCore, &perftResults, n]()
-            {
-                perftTest(depth, moveListCore, perftResults, n);
-            }
-        };
+u64 ChessUCI::perftDepthTest(int depth, const int maxDepth, const MoveList &moveList, Engine &engine, NodeCounter &counter, bool bulkCounting)
+{
+    if(depth<=0 || counter.poll())
+        return 1;
 
-        //Create the Thread
-        perftThreadList.emplace_back(createThread);
+    //Bulk-Counting: Only test which moves of the last ply are legal.
+    if(depth == 1 && bulkCounting)
+    {
+        const Position position = engine.getPosition();
+        u64 nodes = 0;
+        for(const ChessMove &move : moveList)
+            nodes += position.isLegal(move);
+        return nodes;
     }
 
-    //Wait for all threads to finish
-    for(int n=0; n<nCores; n++)
+    //Transposed Positions are only counted once. At maxDepth moveList may be limited to a single move, so the root is never stored.
+    //Without bulkCounting every move is made, so the table is not used either.
+    u64 hash = 0, nodes = 0;
+    const bool useTable = (bulkCounting && depth >= 2 && depth < maxDepth);
+    if(useTable)
     {
-        perftThreadList[n].join();
+        hash = engine.getPosition().hash;
+        if(perftTable.probe(hash, depth, nodes))
+            return nodes;
     }
 
-    //Print the Results
-    std::lock_guard<std::mutex> lock(mtx);
-    if(stopThread.load())
-        std::cout << "Search aborted! Nodes found so far:\n";
+    engine.saveBoardState(engine.turnCounter + maxDepth - depth);
 
-    u64 sum = 0;
-    const std::size_t nMovesFound = perftResults.size();
-    for(std::size_t m=0; m<nMovesFound; m++)
+    for( const ChessMove &move : moveList )
     {
-        sum += perftResults[m].nodes;
+        if(counter.isStopped())
+            return nodes;
+
+        const bool isLegal = engine.makeMove(move);
+
+        if(isLegal)
+        {
+            engine.turnColour = (engine.turnColour == PWHITE) ? PBLACK : PWHITE;
+
+            const PColour c = engine.turnColour;
+            const MoveList newMoveList(engine.moveListPseudo[c], engine.moveListPseudo[c] + engine.nMovesPseudo[c]);
+
+            u64 newNodes = perftDepthTest(depth-1, maxDepth, newMoveList, engine, counter, bulkCounting);
+            nodes += newNodes;
+        }
+
+        engine.loadTestBoardState(engine.turnCounter + maxDepth - depth);
     }
 
-    const double time = Chess::CLOCK.getTime() - tStart;
-    std::cout << "\nNodes:\t" << sum << '\n';
-    std::cout << "Time:\t" << time << "s\n";
-    std::cout << "Speed:\t" << sum/time << " nodes/s\n\n";
+    if(useTable && !counter.isStopped())
+        perftTable.store(hash, depth, nodes);
 
-    threadDone[threadID] = true;
+    return nodes;
 }
 
-void ChessUCI::perftTest(const int depth, std::vector<ChessMove> moveList, std::vector<PerftResult> &perftResults, const std::size_t threadID)
+u64 ChessUCI::perftDepthTest(int depth, const Position &position, NodeCounter &counter, bool bulkCounting)
 {
-    auto testEngine{ std::make_unique<Engine>() };  //Board on which the perft-Test will be made. Needed for multiple threads.
-    testEngine->initialize();
-    testEngine->loadFEN(mainEngine.getFEN().c_str());
-    const std::size_t startTurn = testEngine->turnCounter;
+    if(depth<=0 || counter.poll())
+        return 1;
 
-    const std::size_t nMoves = moveList.size();
-    for(std::size_t m=0; m<nMoves; m++)
-    {
-        if(stopThread.load())
-            break;
+    if(depth == 1 && bulkCounting)
+        return position.countLegalMoves();
+
+    //Without bulkCounting every move is made, so the table is not used either.
+    u64 nodes = 0;
+    const bool useTable = (bulkCounting && depth >= 2);
+    if(useTable && perftTable.probe(position.hash, depth, nodes))
+        return nodes;
 
-        std::vector<ChessMove> move{ moveList[m] };
-        u64 result = perftDepthTest(depth, depth, move, testEngine);
+    MoveList moveList;
+    position.generateMoves(moveList);
 
-        mtx2.lock();
-        perftResults.push_back( { result, moveList[m] } );
-        mainEngine.printMove(moveList[m]);
-        std::cout << ": " << result << '\n';
-        mtx2.unlock();
+    for(const ChessMove &move : moveList)
+    {
+        if(counter.isStopped())
+            return nodes;
 
-        testEngine->loadBoardState(startTurn);
+        Position next;
+        if(position.makeMove(move, next))
+            nodes += perftDepthTest(depth-1, next, counter, bulkCounting);
     }
+
+    if(useTable && !counter.isStopped())
+        perftTable.store(position.hash, depth, nodes);
+
+    return nodes;
 }
 
-u64 ChessUCI::perftDepthTest(int depth, const int maxDepth, const std::vector<ChessMove> &moveList, std::unique_ptr<Engine> &engine)
+//Perft-Suite Functions
+
+void ChessUCI::executePerftSuiteCommand()
 {
-    if(depth<=0 || stopThread.load())
-        return 1;
+    enum SuiteOptions
+    {
+        DEPTH,
+        EPDFILE,
+    };
 
-    engine->saveBoardState(engine->turnCounter + maxDepth - depth);
+    int maxDepth = 5;
+    std::vector<PerftSuiteEntry> suite = testPositions;
 
-    u64 nodes =  0;
+    try
+    {
+        if(inputParameters[DEPTH] != "NO_OPTION" && inputParameters[DEPTH] != "NO_PARAMETER")
+            maxDepth = std::stoi(inputParameters[DEPTH]);
+    }
+    catch(...)
+    {
+        std::cout << "ERROR: Invalid Parameter for depth!\n";
+        return;
+    }
 
-    for( const ChessMove &move : moveList )
+    if(inputParameters[EPDFILE] != "NO_OPTION" && inputParameters[EPDFILE] != "NO_PARAMETER")
     {
-        if(stopThread.load())
-            return nodes;
+        const std::string path = trimParameter(inputParameters[EPDFILE]);
+        if(!loadPerftSuite(path.c_str(), suite))
+        {
+            std::cout << "ERROR: Could not read the EPD-File " << path << "!\n";
+            return;
+        }
+    }
 
-        const bool isLegal = engine->makeMove(move);
+    threadPool.submit(jobs, [suite, maxDepth]()
+    {
+        CancelToken token{&stopToken};
+        runPerftSuite(suite, maxDepth, token);
+    });
+}
 
-        if(isLegal)
+u64 ChessUCI::perftCount(int depth, const Position &position, CancelToken &token)
+{
+    std::atomic<u64> nodes{0};
+    TaskGroup group{};
+    perftSplit(depth, std::max(1, perftSplitDepth.load()), position, nodes, group, token, true);
+    threadPool.wait(group);
+    return nodes.load();
+}
+
+bool ChessUCI::loadPerftSuite(const char *path, std::vector<PerftSuiteEntry> &suite)
+{
+    std::ifstream file(path);
+    if(!file)
+        return false;
+
+    std::string line{};
+    while(std::getline(file, line))
+    {
+        //The FEN is followed by fields like ";D1 20".
+        const std::size_t end = line.find(';');
+        PerftSuiteEntry entry{trimParameter(line.substr(0, end)), {}};
+        if(entry.FEN.empty() || end == std::string::npos)
+            continue;
+
+        std::stringstream fields(line.substr(end));
+        std::string field{};
+        while(std::getline(fields, field, ';'))
         {
-            engine->turnColour = (engine->turnColour == PWHITE) ? PBLACK : PWHITE;
+            field = trimParameter(field);
+            if(field.size() < 2 || field[0] != 'D')
+                continue;
 
-            std::vector<ChessMove> newMoveList{};
-            const PColour c = engine->turnColour;
-            newMoveList.assign(engine->moveListPseudo[c], engine->moveListPseudo[c] + engine->nMovesPseudo[c]);
+            try
+            {
+                std::size_t length = 0;
+                const int depth = std::stoi(field.substr(1), &length);
+                const u64 nodes = std::stoull(field.substr(1 + length));
+                if(depth < 1)
+                    continue;
+                if((int)entry.nodes.size() < depth)
+                    entry.nodes.resize(depth, 0);
+                entry.nodes[depth-1] = nodes;
+            }
+            catch(...)
+            {
+                continue;
+            }
+        }
 
-            u64 newNodes = perftDepthTest(depth-1, maxDepth, newMoveList, engine);
-            nodes += newNodes;
+        if(!entry.nodes.empty())
+            suite.push_back(entry);
+    }
+
+    return true;
+}
+
+bool ChessUCI::runPerftSuite(const std::vector<PerftSuiteEntry> &suite, int maxDepth, CancelToken &token)
+{
+    EnginePool::Handle engine = enginePool.acquire();
+    u64 totalNodes = 0;
+    double totalTime = 0.0;
+    int nFailed = 0;
+
+    PerfCounters counters{};
+    startPerfCounters(counters);
+
+    for(std::size_t n=0; n<suite.size() && !token.isCancelled(); n++)
+    {
+        const PerftSuiteEntry &entry = suite[n];
+        engine->loadFEN(entry.FEN.c_str());
+        const Position position = engine->getPosition();
+
+        u64 positionNodes = 0;
+        double positionTime = 0.0;
+        const int depthMax = std::min(maxDepth, (int)entry.nodes.size());
+        for(int depth=1; depth<=depthMax && !token.isCancelled(); depth++)
+        {
+            if(entry.nodes[depth-1] == 0)
+                continue;
+
+            //Start from an empty table, so neither the speed nor the result depends on counts cached by an earlier run.
+            perftTable.clear();
+
+            const double tStart = Chess::CLOCK.getTime();
+            const u64 nodes = perftCount(depth, position, token);
+            positionTime += Chess::CLOCK.getTime() - tStart;
+            positionNodes += nodes;
+
+            if(token.isCancelled())
+                break;
+
+            const bool correct = (nodes == entry.nodes[depth-1]);
+            nFailed += !correct;
+
+            std::lock_guard<std::mutex> lock(mtx);
+            std::cout << "Position " << n+1 << ", depth " << depth << ": " << nodes;
+            if(correct)
+                std::cout << " OK\n";
+            else
+                std::cout << " FAILED, expected " << entry.nodes[depth-1] << '\n';
         }
 
-        engine->loadTestBoardState(engine->turnCounter + maxDepth - depth);
+        totalNodes += positionNodes;
+        totalTime += positionTime;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        std::cout << "Position " << n+1 << ": " << positionNodes << " nodes in " << positionTime << "s, " << (u64)(positionNodes / std::max(positionTime, 1e-9)) << " nodes/s\n\n";
     }
 
-    return nodes;
+    std::lock_guard<std::mutex> lock(mtx);
+    if(token.isCancelled())
+        std::cout << "Suite aborted!\n";
+    std::cout << "Nodes:\t" << totalNodes << '\n';
+    std::cout << "Time:\t" << totalTime << "s\n";
+    std::cout << "Speed:\t" << (u64)(totalNodes / std::max(totalTime, 1e-9)) << " nodes/s\n";
+    printPerfCounters(counters, totalNodes);
+    if(nFailed == 0 && !token.isCancelled())
+        std::cout << "Perft suite passed.\n\n";
+    else
+        std::cout << "Perft suite FAILED: " << nFailed << " wrong results.\n\n";
+
+    return nFailed == 0 && !token.isCancelled();
+}
+
+int ChessUCI::runPerftSuite(int argc, char *argv[])
+{
+    const std::vector<char*> args = extractPerfArgument(argc, argv);
+    const int maxDepth = (args.size() > 0) ? std::atoi(args[0]) : 5;
+    if(maxDepth < 1)
+    {
+        std::cout << "Usage: perft [max-depth] [epd-file] [perf]\n";
+        return 1;
+    }
+
+    Chess::initialize();
+
+    std::vector<PerftSuiteEntry> suite = testPositions;
+    if(args.size() > 1 && !loadPerftSuite(args[1], suite))
+    {
+        std::cerr << "ERROR: Could not read the EPD-File " << args[1] << "!\n";
+        return 1;
+    }
+
+    CancelToken token{&globalToken};
+    const bool passed = runPerftSuite(suite, maxDepth, token);
+    threadPool.stop();
+    return passed ? 0 : 1;
 }
 
 void ChessUCI::executeGoCommand()
@@ -622,21 +1088,31 @@ void ChessUCI::executeGoCommand()
         else
             depth = Chess::botList[mainEngine.turnColour].depth;
 
+        //Get the time and node limits. 0 means no limit.
+        double moveTime = 0.0;
+        if(inputParameters[3] != "NO_OPTION" && inputParameters[3] != "NO_PARAMETER")
+            moveTime = std::stod(inputParameters[3]) / 1000.0;
+
+        u64 maxNodes = 0;
+        if(inputParameters[4] != "NO_OPTION" && inputParameters[4] != "NO_PARAMETER")
+            maxNodes = std::stoull(inputParameters[4]);
+
         //Get the Bottype
         BotTypes bottype = OPTIMUMBOT2;
-        if(inputParameters[2] != "NO_OPTION" && inputParameters[2] != "NO_PARAMETER")
+        const std::string botName = trimParameter(inputParameters[2]);
+        if(botName != "NO_OPTION" && botName != "NO_PARAMETER")
         {
-            if(inputParameters[2] == "random")
+            if(botName == "random")
                 bottype = RANDOMBOT;
-            else if(inputParameters[2] == "metro")
+            else if(botName == "metro")
                 bottype = METROPOLISBOT;
-            else if(inputParameters[2] == "fool")
+            else if(botName == "fool")
                 bottype = WEIGHTEDRANDOMBOT1;
-            else if(inputParameters[2] == "jester")
+            else if(botName == "jester")
                 bottype = WEIGHTEDRANDOMBOT2;
-            else if(inputParameters[2] == "novice")
+            else if(botName == "novice")
                 bottype = OPTIMUMBOT1;
-            else if(inputParameters[2] == "master")
+            else if(botName == "master")
                 bottype = OPTIMUMBOT1;
             else
             {
@@ -647,96 +1123,191 @@ void ChessUCI::executeGoCommand()
         else
             bottype = Chess::botList[mainEngine.turnColour].botType;
 
-        //Only OptimumBot2 can make use of a custom movelist.
-        if(bottype == OPTIMUMBOT2)
-        {
-            //Get the requested MoveList.
-            std::vector<ChessMove> moveList{};
-            int nMoves = extractChessMoves(inputParameters[1].c_str(), moveList);
-
-            //If no Movelist was provided, use moveListLegal.
-            if(nMoves <= 0)
-            {
-                const PColour l = mainEngine.turnColour;
-                nMoves = mainEngine.nMovesLegal[l];
-                moveList.resize(nMoves);
-                for(int m=0; m<nMoves; m++)
-                {
-                    moveList[m] = mainEngine.moveListLegal[l][m];
-                }
-            }
-
-            //Lambda to create a thread
-            auto createThread
-            {
-                [depth,moveList]()
-                {
-                    findBestMove(depth,moveList, threadList.size()-1);
-                }
-            };
+        SearchLimits limits{depth, moveTime, maxNodes};
 
-            //Create the Thread
-            threadDone.emplace_back(false);
-            threadList.emplace_back(createThread);
-        }
-        else
-        {
-            //Warn the User if they requested a movelist.
-            if(inputParameters[1] != "NO_OPTION" && inputParameters[1] != "NO_PARAMETER")
-                std::cout << "info Warning: Only bottype optimum2 can make use of the searchmoves command!\n";
+        //Only OptimumBot2 can make use of a custom movelist. Without one, all legal moves are searched.
+        if(bottype == OPTIMUMBOT2)
+            extractChessMoves(inputParameters[1].c_str(), limits.searchMoves);
 
-            //Lambda to create a thread
-            auto createThread
-            {
-                [depth,bottype]()
-                {
-                    findNextMove(depth,bottype, threadList.size()-1);
-                }
-            };
+        //Warn the User if they requested a movelist.
+        else if(inputParameters[1] != "NO_OPTION" && inputParameters[1] != "NO_PARAMETER")
+            std::cout << "info Warning: Only bottype optimum2 can make use of the searchmoves command!\n";
 
-            //Create the Thread
-            threadDone.emplace_back(false);
-            threadList.emplace_back(createThread);
-        }
+        //The search reports back via callbacks, so the console stays responsive without waiting for it.
+        //A previous search still reads botType, so it is stopped before the type changes.
+        searchBot.stop();
+        searchBot.botType = bottype;
+        searchRequest = searchBot.requestMove(mainEngine.getFEN(), limits, printSearchInfo, printBestMove);
     }
 
     catch(const std::invalid_argument &e)
     {
         e;
-        std::cerr << "ERROR: Invalid Parameter for go depth! Specify the depth with int.\n";
+        std::cerr << "ERROR: Invalid Parameter for go! Specify depth, movetime and nodes with int.\n";
     }
 
     catch(const std::out_of_range &e)
     {
         e;
-        std::cerr << "ERROR: Invalid Parameter for go depth! int Overflow.\n";
+        std::cerr << "ERROR: Invalid Parameter for go! int Overflow.\n";
     }
 }
 
-void ChessUCI::findNextMove(int depth, BotTypes bottype, const std::size_t threadID)
+void ChessUCI::printSearchInfo(const SearchInfo &info)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    std::cout << "info depth " << info.depth << " score cp " << info.score << " nodes " << info.nodes << " pv ";
+    mainEngine.printMove(info.bestMove);
+    std::cout << '\n';
+}
+
+void ChessUCI::printBestMove(const SearchInfo &info)
 {
-    threadDone[threadID] = false;
-    auto bot = std::make_unique<Bot>(mainEngine.turnColour);
-    bot->depth = depth;
-    bot->botType = bottype;
-    bot->generateMove();
-    while(bot->searching);
+    std::lock_guard<std::mutex> lock(mtx);
+    if(searchStatsEnabled)
+    {
+        lastSearchStats = info.stats;
+        lastSearchStats.print(std::cout);
+    }
+#ifndef NDEBUG
+    //Shows how much of the scratch memory per thread the move ordering needs.
+    std::cout << "info string arena peak " << info.arenaPeak << " of " << SearchContext::scratchSize << " bytes\n";
+#endif
     std::cout << "bestmove ";
-    mainEngine.printMove(bot->nextMove);
+    mainEngine.printMove(info.bestMove);
     std::cout << '\n' << '\n';
-    threadDone[threadID] = true;
 }
 
-void ChessUCI::findBestMove(int depth, std::vector<ChessMove> moveList, const std::size_t threadID)
+void ChessUCI::executeBenchCommand()
 {
-    auto bot = std::make_unique<Bot>(mainEngine.turnColour);
-    bot->depth = depth;
+    int depth = 4;
+    try
+    {
+        if(inputParameters[0] != "NO_OPTION" && inputParameters[0] != "NO_PARAMETER")
+            depth = std::stoi(inputParameters[0]);
+    }
+    catch(...)
+    {
+        std::cout << "ERROR: Invalid Parameter for bench! Specify the depth with int.\n";
+        return;
+    }
 
-    //Find the best Move.
-    bot->findOptimumMove(moveList);
+    threadPool.submit(jobs, [depth]()
+    {
+        CancelToken token{&stopToken};
+        runBench(depth, token);
+    });
+}
 
-    std::cout << "bestmove ";
-    mainEngine.printMove(bot->nextMove);
-    std::cout << '\n' << '\n';
-    threadDone[threadID] = true;
-}
\ No newline at end of file
+u64 ChessUCI::runBench(int depth, CancelToken &token)
+{
+    //A single thread, so the nodes do not depend on how the moves are split among threads.
+    Bot bot{PWHITE, &token};
+    bot.botType = OPTIMUMBOT2;
+    bot.nThreadsBot = 1;
+
+    std::vector<std::string> positions{};
+    for(const PerftSuiteEntry &entry : testPositions)
+        positions.push_back(entry.FEN);
+    positions.insert(positions.end(), benchPositions.begin(), benchPositions.end());
+
+    PerfCounters counters{};
+    startPerfCounters(counters);
+
+    u64 totalNodes = 0;
+    const double tStart = Chess::CLOCK.getTime();
+    for(std::size_t n=0; n<positions.size() && !token.isCancelled(); n++)
+    {
+        MoveRequest request = bot.requestMove(positions[n], {depth});
+        request.wait();
+        const SearchInfo info = request.getProgress();
+        totalNodes += info.nodes;
+
+        std::lock_guard<std::mutex> lock(mtx);
+        std::cout << "Position " << n+1 << "/" << positions.size() << ": ";
+        mainEngine.printMove(info.bestMove);
+        std::cout << ", " << info.nodes << " nodes\n";
+    }
+    const double time = Chess::CLOCK.getTime() - tStart;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if(token.isCancelled())
+        std::cout << "Bench aborted!\n";
+    std::cout << "\nNodes:\t" << totalNodes << '\n';
+    std::cout << "Time:\t" << time << "s\n";
+    std::cout << "Speed:\t" << (u64)(totalNodes / std::max(time, 1e-9)) << " nodes/s\n";
+    printPerfCounters(counters, totalNodes);
+    std::cout << '\n';
+    return totalNodes;
+}
+
+int ChessUCI::runBench(int argc, char *argv[])
+{
+    const std::vector<char*> args = extractPerfArgument(argc, argv);
+    const int depth = (args.size() > 0) ? std::atoi(args[0]) : 4;
+    if(depth < 1)
+    {
+        std::cout << "Usage: bench [depth] [perf]\n";
+        return 1;
+    }
+
+    Chess::initialize();
+    CancelToken token{&globalToken};
+    runBench(depth, token);
+    threadPool.stop();
+    return 0;
+}
+
+bool ChessUCI::startPerfCounters(PerfCounters &counters)
+{
+    if(!perfCounters)
+        return false;
+
+    //The calling thread may wait for the tasks without being a worker.
+    std::vector<long> tids = threadPool.threadIds();
+    const long tid = PerfCounters::currentThreadId();
+    if(tid != 0 && std::find(tids.begin(), tids.end(), tid) == tids.end())
+        tids.push_back(tid);
+
+    if(!counters.open(tids))
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::cout << "info string Could not open the performance counters. They need Linux and /proc/sys/kernel/perf_event_paranoid at 2 or lower.\n";
+        return false;
+    }
+
+    counters.start();
+    return true;
+}
+
+void ChessUCI::printPerfCounters(PerfCounters &counters, u64 nodes)
+{
+    if(!counters.isOpen())
+        return;
+
+    counters.stop();
+    const PerfCounters::Sample sample = counters.read();
+    const double n = (double)std::max<u64>(nodes, 1);
+
+    if(sample.available[PerfCounters::CYCLES] && sample.available[PerfCounters::INSTRUCTIONS] && sample.counts[PerfCounters::CYCLES] > 0)
+        std::cout << "IPC:\t" << (double)sample.counts[PerfCounters::INSTRUCTIONS] / sample.counts[PerfCounters::CYCLES] << '\n';
+
+    const char *names[PerfCounters::NEVENTS] = {"Cycles", "Instructions", "Cache misses", "Branch misses", "LLC misses"};
+    for(int e=0; e<PerfCounters::NEVENTS; e++)
+    {
+        std::cout << names[e] << "/node:\t";
+        if(sample.available[e])
+            std::cout << sample.counts[e] / n << '\n';
+        else
+            std::cout << "n/a\n";
+    }
+}
+
+std::vector<char*> ChessUCI::extractPerfArgument(int argc, char *argv[])
+{
+    std::vector<char*> args(argv, argv + argc);
+    std::erase_if(args, [](const char *arg) { return std::string_view(arg) == "perf"; });
+    if((int)args.size() < argc)
+        perfCounters = true;
+    return args;
+}
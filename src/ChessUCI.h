@@ -1,5 +1,6 @@
 #pragma once
 #include "ChessEngine.h"
+#include "PerfCounters_Header.h"
 
 namespace ChessUCI
 {
@@ -8,12 +9,24 @@ namespace ChessUCI
 	//Stores User-Input in inputString and translates it into a UCI-command.
 	void inputUCI();
 
+	//Cancels all searches and perft-Tests started via UCI and waits for them. Bots of the GUI keep running.
+	void stopSearches();
+
+	//Waits until all searches and perft-Tests, including the ones of the GUI Bots, have finished. Used before changing an option they read.
+	void waitForSearches();
+
 	//Takes inputString, searches for the Options set by command and stores any parameters in inputParameters.
 	bool UCIsetCommandParameters(std::string_view command, std::vector<std::string_view> options); //Sets inputCommand and inputParameters. Returns false if command != inputCommand.
 
 	//Display all available commands.
 	void executeHelpCommand();
 
+	//Sets an engine option via "setoption name [name] value [value]".
+	void executeSetOptionCommand();
+
+	//Removes leading and trailing whitespace from a Parameter.
+	std::string trimParameter(const std::string &parameter);
+
 	//Display Information such as the current board or Dangerzones.
 	void executeDisplayCommand();
 
@@ -26,9 +39,14 @@ namespace ChessUCI
 	//Executes the go perft Command.
 	void executePerftCommand();
 
-	void findNextMove(int depth, BotTypes bottype, const std::size_t threadID);
+	//Executes the perft suite Command.
+	void executePerftSuiteCommand();
 
-	void findBestMove(int depth, std::vector<ChessMove> moveList, const std::size_t threadID);
+	//Prints the progress of the search started by the go Command.
+	void printSearchInfo(const SearchInfo &info);
+
+	//Prints the move chosen by the search started by the go Command.
+	void printBestMove(const SearchInfo &info);
 
 	//Perft-Test Functions.
 
@@ -39,20 +57,123 @@ namespace ChessUCI
 		ChessMove move;
 	};
 
-	//A main-thread that handles several perft-Test threads.
-	void perftMainThread(const int depth, int nCores, const std::vector<ChessMove> &moveList, const std::size_t threadID);
+	//A task that splits the perft-Test into subtrees on the threadPool and prints the results per move of moveList.
+	void perftMainThread(const int depth, const std::vector<ChessMove> &moveList, bool bulkCounting);
+
+	//Expand position for splitPly more plies and submit every subtree reached to group as its own task. Adds the nodes found to nodes.
+	void perftSplit(int depth, int splitPly, const Position &position, std::atomic<u64> &nodes, TaskGroup &group, CancelToken &token, bool bulkCounting);
+
+	//Perform the actual Perft-Test iteratively. With bulkCounting the legal moves of the last ply are counted instead of made and the perftTable is used, without it every move is made.
+	u64 perftDepthTest(int depth, const int maxDepth, const MoveList &moveList, Engine &engine, NodeCounter &counter, bool bulkCounting);
+
+	//Perform the Perft-Test on a Position via copy-make.
+	u64 perftDepthTest(int depth, const Position &position, NodeCounter &counter, bool bulkCounting);
+
+	//Perft-Suite Functions.
+
+	//A position with its known perft-Results, nodes[d-1] for depth d. 0 if the result for a depth is unknown.
+	struct PerftSuiteEntry
+	{
+		std::string FEN;
+		std::vector<u64> nodes;
+	};
+
+	//Count the nodes of position at depth, split into tasks on the threadPool.
+	u64 perftCount(int depth, const Position &position, CancelToken &token);
+
+	//Add the positions of an EPD-File with the perft-Results annotated like "[FEN] ;D1 20 ;D2 400" to suite. Returns false if the file could not be read.
+	bool loadPerftSuite(const char *path, std::vector<PerftSuiteEntry> &suite);
 
-	//Call to perform a Perft-Test with depth and store the results.
-	void perftTest(const int depth, std::vector<ChessMove> moveList, std::vector<PerftResult> &perftResults, const std::size_t threadID);
+	//Count every position of suite up to maxDepth and compare with the known results. Prints the speed per position and in total. Returns true if all counts match.
+	bool runPerftSuite(const std::vector<PerftSuiteEntry> &suite, int maxDepth, CancelToken &token);
 
-	//Perform the actual Perft-Test iteratively.
-	u64 perftDepthTest(int depth, const int maxDepth, const std::vector<ChessMove> &moveList, std::unique_ptr<Engine> &engine);
+	//Command line mode "perft [max-depth] [epd-file] [perf]": Runs the testPositions and the positions of the file without opening a window. Returns 0 if all counts match.
+	int runPerftSuite(int argc, char *argv[]);
 
 	//Execute the regular go Command.
 	void executeGoCommand();
 
+	//Executes the bench Command.
+	void executeBenchCommand();
+
+	//Search every position of testPositions and benchPositions with depth on a single thread and print the total nodes, time and nodes/s.
+	//The total nodes are a signature of the search: They only change if the search itself changes. Returns the total nodes.
+	u64 runBench(int depth, CancelToken &token);
+
+	//Command line mode "bench [depth] [perf]": Runs the bench without opening a window.
+	int runBench(int argc, char *argv[]);
+
+	//Hardware-Counter Functions.
+
+	//Open and start the performance counters of the workers and the calling thread if perfCounters is set. Returns false if they are off or could not be opened.
+	bool startPerfCounters(PerfCounters &counters);
+
+	//Stop the counters and print the instructions per cycle and the misses per node. Does nothing if they are not open. Requires mtx.
+	void printPerfCounters(PerfCounters &counters, u64 nodes);
+
+	//Remove the argument "perf" from the command line arguments and turn on perfCounters if it was found. Returns the remaining arguments.
+	std::vector<char*> extractPerfArgument(int argc, char *argv[]);
+
+	//The standard perft-Positions, loaded via "position testpos [1-6]", with their results from https://www.chessprogramming.org/Perft_Results
+	inline const std::vector<PerftSuiteEntry> testPositions =
+	{
+		{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ",                 {20, 400, 8902, 197281, 4865609, 119060324}},              //Position 1, Standard.
+		{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - ",        {48, 2039, 97862, 4085603, 193690690, 8031647685}},        //Position 2, Kiwipete, for testing casteling.
+		{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",                                {14, 191, 2812, 43238, 674624, 11030083}},                 //Position 3, for testing en-passant.
+		{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",         {6, 264, 9467, 422333, 15833292, 706045033}},              //Position 4, for testing promotions.
+		{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",                {44, 1486, 62379, 2103487, 89941194, 3048196529}},         //Position 5.
+		{"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", {46, 2079, 89890, 3894594, 164075551, 6923051137}},        //Position 6.
+	};
+
+	//Further positions for the bench Command, from the opening to the endgame.
+	inline const std::vector<std::string> benchPositions =
+	{
+		"r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
+		"4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+		"r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+		"6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+		"8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+		"7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+		"r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
+		"3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
+		"2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
+		"4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
+		"2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
+		"1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
+		"r3kbbr/pp1n1p1P/3ppnp1/q5N1/1P1pP3/P1N1B3/2P1QP2/R3KB1R b KQkq b3 0 17",
+		"8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
+		"1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
+		"8/p2B4/PkP5/4p1pK/4Pb1p/5P2/8/8 w - - 29 68",
+		"3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
+		"5rr1/4n2k/4q2P/P1P2n2/3B1p2/4pP2/2N1P3/1RR1K2Q w - - 1 49",
+		"1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
+		"q5k1/5ppp/1r3bn1/1B6/P1N2P2/BQ2P1P1/5K1P/8 b - - 2 34",
+		"r1b2k1r/5n2/p4q2/1ppn1Pp1/3pp1p1/NP2P3/P1PPBK2/1RQN2R1 w - - 0 22",
+		"r1bqk2r/pppp1ppp/5n2/4b3/4P3/P1N5/1PP2PPP/R1BQKB1R w KQkq - 0 5",
+		"r1bqr1k1/pp1p1ppp/2p5/8/3N1Q2/P2BB3/1PP2PPP/R3K2n b Q - 1 12",
+		"r1bq2k1/p4r1p/1pp2pp1/3p4/1P1B3Q/P2B1N2/2P3PP/4R1K1 b - - 2 19",
+		"r4qk1/6r1/1p4p1/2ppBbN1/1p5Q/P7/2P3PP/5RK1 w - - 2 25",
+		"r7/6k1/1p6/2pp1p2/7Q/8/p1P2K1P/8 w - - 0 32",
+		"r3k2r/ppp1pp1p/2nqb1pn/3p4/4P3/2PP4/PP1NBPPP/R2QK1NR w KQkq - 1 5",
+		"3r1rk1/1pp1pn1p/p1n1q1p1/3p4/Q3P3/2P5/PP1NBPPP/4RRK1 w - - 0 12",
+		"5rk1/1pp1pn1p/p3Brp1/8/1n6/5N2/PP3PPP/2R2RK1 w - - 2 20",
+		"8/1p2pk1p/p1p1r1p1/3n4/8/5R2/PP3PPP/4R1K1 b - - 3 27",
+		"8/4pk2/1p1r2p1/p1p4p/Pn5P/3R4/1P3PP1/4RK2 w - - 1 33",
+		"8/5k2/1pnrp1p1/p1p4p/P6P/4R1PK/1P3P2/4R3 b - - 1 38",
+		"8/8/1p1kp1p1/p1pr1n1p/P6P/1R4P1/1P3PK1/1R6 b - - 15 45",
+		"8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/6R1 b - - 6 59",
+	};
+
 	//UCI Variables
 	inline std::string inputString;						//Stores the User-Input.
 	inline std::vector<std::string> inputParameters;	//A Vector containing the Parameters from the User-Input.
 	inline std::atomic<bool> stopMainThread{false};		//To stop the main UCI thread.
+	inline CancelToken stopToken{&globalToken};			//Parent of the tokens of all jobs started via UCI. Cancelled by the stop-command.
+	inline TaskGroup jobs{};							//All perft-Tests started via UCI.
+	inline Bot searchBot{PWHITE, &stopToken};			//Bot used by the go Command. Plays the side to move of the position.
+	inline MoveRequest searchRequest{};					//The last search started by the go Command.
+	inline SearchStats lastSearchStats{};				//Statistics of the last search finished by the go Command. Protected by mtx.
+	inline std::atomic<int> perftSplitDepth{2};			//Plies below the root after which perft-Tests are split into tasks.
+	inline std::atomic<bool> perfCounters{false};		//Measure the workers with hardware performance counters during perft and bench.
+	inline std::string traceFile{};						//File the timeline is written to once recording stops. Empty if nothing is recorded.
 }
\ No newline at end of file
@@ -576,9 +576,11 @@ void LevelChessboard::pptTransformPawn(Chess::PType type)
 
 void LevelChessboard::resetBots()
 {
-	stopAllThreads();
+	botList[PWHITE].stop();
+	botList[PBLACK].stop();
 	botList[PWHITE].reset();
 	botList[PBLACK].reset();
+	botRequest = {};
 }
 
 void LevelChessboard::botThink(Chess::Bot &bot, double tStartBotSearch)
@@ -944,25 +946,26 @@ void LevelChessboard::inputBots()
 	Bot &bot{botList[mainEngine.turnColour]};
 	static double tStartBotSearch = 0.0;
 
-	if(!bot.searching && !bot.moveChosen)
+	//The search runs on the threadPool, every frame only checks whether it has finished.
+	if(!botRequest.valid())
 	{
 		tStartBotSearch = Raylib::CLOCK.getTime();
-		bot.generateMove();
+		botRequest = bot.requestMove(mainEngine.getFEN(), {bot.depth});
 	}
-	else if(bot.searching)
+	else if(!botRequest.ready())
 	{
 		botThink(bot, tStartBotSearch);
 	}
-	else if(bot.moveChosen && !bot.spriteMoved)
+	else if(!bot.spriteMoved)
 	{
-		cleanUpThreads();
+		bot.nextMove = botRequest.get();
 		botSetSpriteDest(bot, tStartBotSearch);
 	}
-	else if(bot.spriteMoved && !bot.spriteArrived)
+	else if(!bot.spriteArrived)
 	{
 		botTestSpriteDest(bot);
 	}
-	else if(bot.moveChosen && bot.spriteArrived)
+	else
 	{
 		const int weightOld = mainEngine.getBoardWeight();
 		bot.executeMove();
@@ -976,6 +979,7 @@ void LevelChessboard::inputBots()
 
 		setChessPieceSpritePos();
 		bot.reset();
+		botRequest = {};
 	}
 }
 
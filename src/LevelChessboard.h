@@ -180,6 +180,7 @@ private:
     const float speed = 10.0f;                                                                  //Speed with which the chesspieces move.
     int checkCounter[2] = {0,0};                                                                //How often a King was in check. Used only for speeches.                       
     double tReset = -1.5;                                                                       //The bot should wait for some time when reset is called.
+    Chess::MoveRequest botRequest{};                                                            //The move the bot to move is searching for.
     int dialogueCounter = 1;                                                                    //Counter for commentValidMoves.
 
     //Pawn-Transform-Panel Variables
@@ -1,5 +1,7 @@
 #include "ChessGUI.h"
 #include "ChessUCI.h"
+#include "ChessTuning.h"
+#include "ChessMicrobench.h"
 
 #if defined(PLATFORM_WEB)
 #include <emscripten/emscripten.h>
@@ -38,8 +40,20 @@ void updateFrame()
 
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+#if !defined(PLATFORM_WEB)
+	//Headless modes that run without opening a window.
+	if(argc > 1 && std::string(argv[1]) == "tune")
+		return Chess::Tuning::run(argc-2, argv+2);
+	if(argc > 1 && std::string(argv[1]) == "perft")
+		return ChessUCI::runPerftSuite(argc-2, argv+2);
+	if(argc > 1 && std::string(argv[1]) == "bench")
+		return ChessUCI::runBench(argc-2, argv+2);
+	if(argc > 1 && std::string(argv[1]) == "microbench")
+		return Chess::Microbench::run(argc-2, argv+2);
+#endif
+
 	loadGame();
 
 #if defined(PLATFORM_WEB)
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//Hardware performance counters of a list of threads via perf_event_open, without external tools.
+//Only user space is counted. Only supported on Linux, elsewhere open always fails.
+class PerfCounters
+{
+public:
+	enum Event
+	{
+		CYCLES,
+		INSTRUCTIONS,
+		CACHEMISSES,
+		BRANCHMISSES,
+		LLCMISSES,
+		NEVENTS,
+	};
+
+	//Counts summed over all threads. Scaled up if the kernel had to share the hardware counters between events.
+	struct Sample
+	{
+		std::uint64_t counts[NEVENTS]{};
+		bool available[NEVENTS]{};		//False if the event could not be opened, e.g. inside many virtual machines.
+	};
+
+	PerfCounters() = default;
+
+	~PerfCounters()
+	{
+		close();
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters &operator=(const PerfCounters&) = delete;
+
+	//Open every event for the threads with the kernel thread ids tids. The counters stay stopped until start.
+	//Returns false if not a single event could be opened, e.g. because /proc/sys/kernel/perf_event_paranoid forbids it.
+	bool open(const std::vector<long> &tids)
+	{
+		close();
+#ifdef __linux__
+		for(long tid : tids)
+		{
+			for(int e=0; e<NEVENTS; e++)
+			{
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = (e == LLCMISSES) ? PERF_TYPE_HW_CACHE : PERF_TYPE_HARDWARE;
+				attr.config = configs[e];
+				attr.disabled = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				const int fd = (int)syscall(SYS_perf_event_open, &attr, (pid_t)tid, -1, -1, 0);
+				if(fd >= 0)
+					counters.push_back({fd, (Event)e});
+			}
+		}
+#else
+		(void)tids;
+#endif
+		return !counters.empty();
+	}
+
+	//Reset the counters to 0 and let them count.
+	void start()
+	{
+#ifdef __linux__
+		for(const Counter &counter : counters)
+		{
+			ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	void stop()
+	{
+#ifdef __linux__
+		for(const Counter &counter : counters)
+			ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+	}
+
+	Sample read() const
+	{
+		Sample sample{};
+#ifdef __linux__
+		for(const Counter &counter : counters)
+		{
+			//Value, time enabled and time running.
+			std::uint64_t values[3]{};
+			if(::read(counter.fd, values, sizeof(values)) != (ssize_t)sizeof(values))
+				continue;
+
+			sample.available[counter.event] = true;
+			if(values[2] > 0)
+				sample.counts[counter.event] += (std::uint64_t)((double)values[0] * values[1] / values[2]);
+		}
+#endif
+		return sample;
+	}
+
+	void close()
+	{
+#ifdef __linux__
+		for(const Counter &counter : counters)
+			::close(counter.fd);
+#endif
+		counters.clear();
+	}
+
+	bool isOpen() const
+	{
+		return !counters.empty();
+	}
+
+	//Kernel thread id of the calling thread, 0 if the platform has none.
+	static long currentThreadId()
+	{
+#ifdef __linux__
+		return (long)syscall(SYS_gettid);
+#else
+		return 0;
+#endif
+	}
+
+private:
+	struct Counter
+	{
+		int fd;
+		Event event;
+	};
+
+	std::vector<Counter> counters{};
+
+#ifdef __linux__
+	static constexpr std::uint64_t configs[NEVENTS] =
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+		PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	};
+#endif
+};
@@ -1,12 +1,79 @@
 #pragma once
 #include <random> 
+#include <atomic>
+#include <cstdint>
 
 namespace Random //Um Zufallszahlen erzeugen zu knnen
 {
-	//Globales mt19937 Objekt. Erzeugt 64bit int Zufallszahl mit generator().
+	//SplitMix64: Macht aus einer Zahl einen gut durchmischten 64bit Wert. Um Seeds zu erzeugen.
+	inline constexpr uint64_t splitMix(uint64_t x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+
+	//xoshiro256**: Schneller 64bit Generator mit 32 Byte Zustand. Funktioniert mit den std-Verteilungen.
+	class Xoshiro256
+	{
+	public:
+		using result_type = uint64_t;
+
+		explicit Xoshiro256(uint64_t seed = 0) { setSeed(seed); }
+
+		void setSeed(uint64_t seed)
+		{
+			for(uint64_t &x : state)
+			{
+				seed = splitMix(seed);
+				x = seed;
+			}
+		}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT64_MAX; }
+
+		result_type operator()()
+		{
+			const uint64_t result = rotl(state[1] * 5, 7) * 9;
+			const uint64_t t = state[1] << 17;
+			state[2] ^= state[0];
+			state[3] ^= state[1];
+			state[1] ^= state[2];
+			state[0] ^= state[3];
+			state[2] ^= t;
+			state[3] = rotl(state[3], 45);
+			return result;
+		}
+
+	private:
+		static constexpr uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+		uint64_t state[4]{};
+	};
+
 	inline std::random_device rd{};		//random_device: Zuflliger Seed vom Computer bestimmt.
-	inline std::seed_seq seed{ rd(),rd(), rd(), rd(), rd(), rd(), rd(), rd() }; //Erzeugt neuen Seed mit acht Zufallszahlen von rd.
-	inline std::mt19937_64 generator{ seed };
+	inline std::atomic<uint64_t> masterSeed{ (uint64_t(rd()) << 32) | rd() };	//Aus diesem Seed werden alle Generatoren abgeleitet.
+	inline std::atomic<bool> replay{ false };		//True wenn masterSeed fest gesetzt wurde: Dann werden Spiele exakt wiederholt.
+	inline std::atomic<uint64_t> nStreams{ 0 };		//Zhlt die Threads, damit jeder Thread eine eigene Folge erhlt.
+
+	//Jeder Thread hat seinen eigenen Generator, Threads teilen sich also nichts. Erzeugt 64bit int Zufallszahl mit generator().
+	inline thread_local Xoshiro256 generator{ masterSeed.load() ^ splitMix(nStreams.fetch_add(1)) };
+
+	//Setzt den masterSeed und schaltet replay ein. seed = 0: Wieder zuflliger Seed, replay aus.
+	inline void setMasterSeed(uint64_t seed)
+	{
+		//Zuerst den Seed speichern, damit ein Thread, der replay schon sieht, auch den neuen masterSeed liest.
+		masterSeed = (seed != 0) ? seed : ((uint64_t(rd()) << 32) | rd());
+		replay = (seed != 0);
+	}
+
+	//Setzt den Generator dieses Threads auf die Folge stream von masterSeed. Gleicher masterSeed und stream ergeben immer dieselben Zahlen, egal auf welchem Thread.
+	inline void seedThread(uint64_t stream)
+	{
+		generator.setSeed(masterSeed.load() ^ splitMix(stream));
+	}
 
 	//Funktion fr zuflliges uniformverteiltes int
 	inline int randInt(int min, int max)
@@ -0,0 +1,401 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <string>
+#include "Trace_Header.h"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//Counts the unfinished tasks that were submitted together, so one can wait for all of them.
+class TaskGroup
+{
+public:
+	bool done() const { return pending.load() == 0; }
+
+private:
+	friend class ThreadPool;
+	std::atomic<int> pending{0};
+	int queued = 0;						//Tasks of the group that are queued but not yet taken by a worker. Protected by mtx.
+	std::mutex mtx;
+	std::condition_variable finished;	//Notified when the last task is done or a new task is queued.
+};
+
+//Fixed number of worker threads that stay alive and execute submitted tasks.
+//Every worker owns a deque: it takes its newest task from the back, idle workers steal the oldest tasks from the front of the others.
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	~ThreadPool()
+	{
+		stop();
+	}
+
+	//Create nWorkers threads. Does nothing if the pool is already running.
+	void start(int nWorkers)
+	{
+		if(!threads.empty())
+			return;
+
+		if(nWorkers < 1)
+			nWorkers = 1;
+
+		stopping.store(false);
+#ifdef __linux__
+		CPU_ZERO(&allowedCPUs);
+		sched_getaffinity(0, sizeof(allowedCPUs), &allowedCPUs);
+#endif
+		for(int n=0; n<nWorkers; n++)
+			workers.push_back(std::make_unique<Worker>());
+		for(int n=0; n<nWorkers; n++)
+			threads.emplace_back([this, n]() { workerLoop(n); });
+	}
+
+	//Finish all queued tasks and join the workers.
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+			stopping.store(true);
+		}
+		wakeUp.notify_all();
+
+		for(auto &thread : threads)
+		{
+			if(thread.joinable())
+				thread.join();
+		}
+
+		std::lock_guard<std::mutex> lock(settingsMtx);
+		threads.clear();
+		workers.clear();
+	}
+
+	int size() const
+	{
+		return (int)workers.size();
+	}
+
+	//Pin worker n to the CPU cpus[n % cpus.size()], so the workers stop moving between cores. An empty list lets them run on all CPUs again.
+	//Returns false if a CPU is not available to the process or the platform does not support pinning. Also applies to workers started later.
+	bool setAffinity(const std::vector<int> &cpus)
+	{
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock(settingsMtx);
+		for(int cpu : cpus)
+		{
+			if(cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowedCPUs))
+				return false;
+		}
+
+		affinity = cpus;
+		bool success = true;
+		for(std::size_t n=0; n<threads.size(); n++)
+			success &= applyAffinity((int)n, threads[n].native_handle());
+		return success;
+#else
+		return cpus.empty();
+#endif
+	}
+
+	//Set the nice value of all workers. Positive values give them less CPU time than the UI and UCI threads, which keep 0.
+	//Returns false if the platform does not support it or the value is not permitted, e.g. lowering it again without privileges.
+	bool setNice(int value)
+	{
+#ifdef __linux__
+		std::lock_guard<std::mutex> lock(settingsMtx);
+		bool success = true;
+		for(const auto &worker : workers)
+		{
+			if(worker->tid != 0)
+				success &= (setpriority(PRIO_PROCESS, (id_t)worker->tid, value) == 0);
+		}
+		if(success)
+			nice = value;
+		return success;
+#else
+		return value == 0;
+#endif
+	}
+
+	//Describes where the workers run, e.g. "8 workers, 16 CPUs available, pinned to CPUs 0 1 2 3, nice 5".
+	std::string topology()
+	{
+		std::lock_guard<std::mutex> lock(settingsMtx);
+		std::string description = std::to_string(workers.size()) + " workers, " + std::to_string(std::thread::hardware_concurrency()) + " CPUs available";
+		if(affinity.empty())
+			description += ", not pinned";
+		else
+		{
+			description += ", pinned to CPUs";
+			for(int cpu : affinity)
+				description += " " + std::to_string(cpu);
+		}
+		description += ", nice " + std::to_string(nice);
+		return description;
+	}
+
+	//Kernel thread ids of the workers that are running, e.g. to measure them with performance counters. Empty if the platform has none.
+	std::vector<long> threadIds()
+	{
+		std::lock_guard<std::mutex> lock(settingsMtx);
+		std::vector<long> tids{};
+		for(const auto &worker : workers)
+		{
+			if(worker->tid != 0)
+				tids.push_back(worker->tid);
+		}
+		return tids;
+	}
+
+	//Index of the calling worker, -1 if the caller is not a worker of this pool.
+	int workerIndex() const
+	{
+		return (currentPool == this) ? currentWorker : -1;
+	}
+
+	//Queue a task. A worker puts it into its own deque, other threads distribute the tasks among the workers.
+	void submit(Task task)
+	{
+		push(std::move(task), nullptr);
+	}
+
+	//Queue a task that belongs to group.
+	void submit(TaskGroup &group, Task task)
+	{
+		group.pending.fetch_add(1);
+		push([&group, task = std::move(task)]()
+		{
+			task();
+			std::lock_guard<std::mutex> lock(group.mtx);
+			if(group.pending.fetch_sub(1) == 1)
+				group.finished.notify_all();
+		}, &group);
+	}
+
+	//Wait until all tasks of group are done. A waiting worker executes the queued tasks of group meanwhile, so tasks may wait for their own subtasks.
+	//It does not pick up unrelated tasks, which could take much longer than the group itself. While none of its tasks are queued it sleeps.
+	void wait(TaskGroup &group)
+	{
+		const Trace::Scope scope{"wait", "join"};
+		const int index = workerIndex();
+
+		//Holding the lock when the loop ends also waits for the last task to release it after counting down.
+		std::unique_lock<std::mutex> lock(group.mtx);
+		while(!group.done())
+		{
+			if(index >= 0 && group.queued > 0)
+			{
+				lock.unlock();
+				runTask(index, &group);
+				lock.lock();
+			}
+			else
+				group.finished.wait(lock);
+		}
+	}
+
+	//Wait until no task is queued or running. Must not be called from a worker.
+	void waitIdle()
+	{
+		std::unique_lock<std::mutex> lock(sleepMtx);
+		idle.wait(lock, [this]() { return nQueued == 0 && nRunning == 0; });
+	}
+
+private:
+	struct Entry
+	{
+		Task task;
+		TaskGroup *group;
+	};
+
+	struct alignas(64) Worker
+	{
+		std::mutex mtx;
+		std::deque<Entry> tasks;
+		long tid = 0;					//Kernel thread id, to set the nice value and open performance counters. Protected by settingsMtx.
+	};
+
+#ifdef __linux__
+	//Pin thread, the thread of worker index, according to affinity. Requires settingsMtx.
+	bool applyAffinity(int index, pthread_t thread) const
+	{
+		cpu_set_t set;
+		if(affinity.empty())
+			set = allowedCPUs;
+		else
+		{
+			CPU_ZERO(&set);
+			CPU_SET(affinity[index % affinity.size()], &set);
+		}
+		return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+	}
+#endif
+
+	void push(Task task, TaskGroup *group)
+	{
+		if(workers.empty())
+		{
+			task();
+			return;
+		}
+
+		int index = workerIndex();
+		if(index < 0)
+			index = (int)(nextWorker.fetch_add(1) % workers.size());
+
+		//Count the task before it becomes visible, so nQueued never drops below zero.
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+			nQueued++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(workers[index]->mtx);
+			workers[index]->tasks.push_back({std::move(task), group});
+		}
+		wakeUp.notify_one();
+
+		//Wake up workers waiting for the group, so they help with the new task. Notified under the lock, since the group may be destroyed as soon as a waiter gets it.
+		if(group != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(group->mtx);
+			group->queued++;
+			group->finished.notify_all();
+		}
+	}
+
+	//Take the newest own task or steal the oldest task of another worker. If only is set, just tasks of that group are taken.
+	//Returns false if there was nothing to do.
+	bool runTask(int index, const TaskGroup *only = nullptr)
+	{
+		Task task{};
+		TaskGroup *group = nullptr;
+		const int nWorkers = (int)workers.size();
+
+		for(int n=0; n<nWorkers && !task; n++)
+		{
+			Worker &worker = *workers[(index + n) % nWorkers];
+			std::lock_guard<std::mutex> lock(worker.mtx);
+			if(worker.tasks.empty())
+				continue;
+
+			if(only != nullptr)
+			{
+				//Search from the newest task in the own deque and from the oldest task in the others.
+				const std::size_t size = worker.tasks.size();
+				for(std::size_t t=0; t<size; t++)
+				{
+					const std::size_t i = (n == 0) ? size-1-t : t;
+					if(worker.tasks[i].group == only)
+					{
+						task = std::move(worker.tasks[i].task);
+						group = worker.tasks[i].group;
+						worker.tasks.erase(worker.tasks.begin() + i);
+						break;
+					}
+				}
+			}
+			else if(n == 0)
+			{
+				task = std::move(worker.tasks.back().task);
+				group = worker.tasks.back().group;
+				worker.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(worker.tasks.front().task);
+				group = worker.tasks.front().group;
+				worker.tasks.pop_front();
+			}
+		}
+
+		if(!task)
+			return false;
+
+		if(group != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(group->mtx);
+			group->queued--;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+			nQueued--;
+			nRunning++;
+		}
+
+		{
+			const Trace::Scope scope{"task", "pool"};
+			task();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(sleepMtx);
+			nRunning--;
+			if(nQueued == 0 && nRunning == 0)
+				idle.notify_all();
+		}
+		return true;
+	}
+
+	void workerLoop(int index)
+	{
+		currentPool = this;
+		currentWorker = index;
+		Trace::setThreadName("worker " + std::to_string(index));
+
+		//Apply the affinity and nice value set before this worker started.
+#ifdef __linux__
+		{
+			std::lock_guard<std::mutex> lock(settingsMtx);
+			workers[index]->tid = (long)syscall(SYS_gettid);
+			if(!affinity.empty())
+				applyAffinity(index, pthread_self());
+			if(nice != 0)
+				setpriority(PRIO_PROCESS, (id_t)workers[index]->tid, nice);
+		}
+#endif
+
+		while(true)
+		{
+			if(runTask(index))
+				continue;
+
+			std::unique_lock<std::mutex> lock(sleepMtx);
+			wakeUp.wait(lock, [this]() { return stopping.load() || nQueued > 0; });
+			if(stopping.load() && nQueued == 0)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Worker>> workers{};
+	std::vector<std::thread> threads{};
+
+	std::mutex sleepMtx;					//Protects nQueued and nRunning.
+	std::condition_variable wakeUp, idle;
+	int nQueued = 0, nRunning = 0;
+	std::atomic<bool> stopping{false};
+	std::atomic<unsigned int> nextWorker{0};
+
+	std::mutex settingsMtx;					//Protects affinity, nice and the tids of the workers.
+	std::vector<int> affinity{};			//CPU of every worker, empty if they are not pinned.
+	int nice = 0;
+#ifdef __linux__
+	cpu_set_t allowedCPUs{};				//CPUs the process may run on, used when the workers are unpinned.
+#endif
+
+	static inline thread_local const ThreadPool *currentPool = nullptr;
+	static inline thread_local int currentWorker = -1;
+};
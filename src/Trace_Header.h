@@ -0,0 +1,206 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Records a timeline of the work of every thread and writes it as Chrome trace events (JSON), viewable in chrome://tracing or https://ui.perfetto.dev.
+//While nothing is recorded, a Scope only costs a single atomic load.
+namespace Trace
+{
+	//A span of work on one thread, in microseconds since start.
+	struct Event
+	{
+		const char *name;
+		const char *category;
+		std::string args;				//JSON members like "move":"e2e4", without braces.
+		double begin, duration;
+	};
+
+	//The events of a single thread. Its mutex is only contended while the events are cleared or written.
+	struct ThreadBuffer
+	{
+		std::mutex mtx;
+		std::string name;
+		std::vector<Event> events;
+	};
+
+	struct Registry
+	{
+		std::mutex mtx;							//Protects threads.
+		std::deque<ThreadBuffer> threads;		//A deque, so the buffers stay in place when threads are added.
+		std::atomic<std::int64_t> startTime{0};	//Nanoseconds of the steady_clock at start.
+	};
+
+	inline std::atomic<bool> recording{false};
+
+	//Never destroyed, since worker threads may still record while the static objects are destroyed at exit.
+	inline Registry &registry()
+	{
+		static Registry *registry = new Registry{};
+		return *registry;
+	}
+
+	//The buffer of the calling thread, created on first use.
+	inline ThreadBuffer &threadBuffer()
+	{
+		thread_local ThreadBuffer *buffer = []()
+		{
+			Registry &r = registry();
+			std::lock_guard<std::mutex> lock(r.mtx);
+			ThreadBuffer &buffer = r.threads.emplace_back();
+			buffer.name = "thread " + std::to_string(r.threads.size() - 1);
+			return &buffer;
+		}();
+		return *buffer;
+	}
+
+	//Name of the calling thread in the timeline.
+	inline void setThreadName(const std::string &name)
+	{
+		ThreadBuffer &buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock(buffer.mtx);
+		buffer.name = name;
+	}
+
+	//Microseconds since start.
+	inline double now()
+	{
+		const std::int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		return (time - registry().startTime.load(std::memory_order_relaxed)) * 1e-3;
+	}
+
+	//Escape quotes, backslashes and control characters for a JSON string.
+	inline std::string escape(const std::string &text)
+	{
+		std::string escaped{};
+		for(char c : text)
+		{
+			if(c == '"' || c == '\\')
+				escaped += '\\';
+			if((unsigned char)c >= 0x20)
+				escaped += c;
+		}
+		return escaped;
+	}
+
+	//Records the time from its creation to the end of its scope as a span of the calling thread. name and category must be string literals.
+	class Scope
+	{
+	public:
+		Scope(const char *name, const char *category): active{recording.load(std::memory_order_relaxed)}, name{name}, category{category}
+		{
+			if(active)
+				begin = now();
+		}
+
+		~Scope()
+		{
+			if(!active)
+				return;
+
+			const double end = now();
+			ThreadBuffer &buffer = threadBuffer();
+			std::lock_guard<std::mutex> lock(buffer.mtx);
+			buffer.events.push_back({name, category, std::move(args), begin, end - begin});
+		}
+
+		Scope(const Scope&) = delete;
+		Scope &operator=(const Scope&) = delete;
+
+		//False if nothing was recorded when the Scope was created. Arguments only need to be built if it is active.
+		bool isActive() const
+		{
+			return active;
+		}
+
+		//Show key with value when the span is selected in the viewer.
+		void addArg(const char *key, const std::string &value)
+		{
+			if(!active)
+				return;
+			if(!args.empty())
+				args += ',';
+			args += "\"" + escape(key) + "\":\"" + escape(value) + "\"";
+		}
+
+		void addArg(const char *key, long long value)
+		{
+			if(!active)
+				return;
+			if(!args.empty())
+				args += ',';
+			args += "\"" + escape(key) + "\":" + std::to_string(value);
+		}
+
+	private:
+		const bool active;
+		const char *name, *category;
+		std::string args{};
+		double begin = 0.0;
+	};
+
+	//Lock mtx and record the time spent waiting if another thread held it.
+	inline std::unique_lock<std::mutex> lock(std::mutex &mtx, const char *name)
+	{
+		std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+		if(!lock.owns_lock())
+		{
+			const Scope scope{name, "lock"};
+			lock.lock();
+		}
+		return lock;
+	}
+
+	//Discard all recorded events and start recording.
+	inline void start()
+	{
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mtx);
+		for(ThreadBuffer &buffer : r.threads)
+		{
+			std::lock_guard<std::mutex> bufferLock(buffer.mtx);
+			buffer.events.clear();
+		}
+		r.startTime.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		recording.store(true);
+	}
+
+	//Stop recording and write all events to path. Returns false if the file could not be written.
+	inline bool stop(const std::string &path)
+	{
+		recording.store(false);
+
+		std::ofstream file(path);
+		if(!file)
+			return false;
+
+		Registry &r = registry();
+		std::lock_guard<std::mutex> lock(r.mtx);
+		file << std::fixed;
+		file.precision(3);
+		file << "{\"traceEvents\":[\n";
+		bool first = true;
+		for(std::size_t tid=0; tid<r.threads.size(); tid++)
+		{
+			ThreadBuffer &buffer = r.threads[tid];
+			std::lock_guard<std::mutex> bufferLock(buffer.mtx);
+			if(buffer.events.empty())
+				continue;
+
+			file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":\"" << escape(buffer.name) << "\"}}";
+			first = false;
+			for(const Event &event : buffer.events)
+			{
+				file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":" << event.begin << ",\"dur\":" << event.duration
+					<< ",\"pid\":1,\"tid\":" << tid << ",\"args\":{" << event.args << "}}";
+			}
+		}
+		file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+		return (bool)file;
+	}
+}